@@ -0,0 +1,183 @@
+#define _GNU_SOURCE  // CPU sets, sched_setaffinity and pthread_setaffinity_np
+#include "affinity.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Online CPU and where it sits in the topology.
+struct Cpu {
+  int id;
+  int package;  // Physical package (socket) id
+  int core;     // Core id, unique within its package
+  int sibling;  // Rank among the hyperthreads of its core
+};
+
+static struct Cpu cpus[CPU_SETSIZE];  // Online CPUs, ordered by package, core and id
+static size_t num_cpus = 0;
+static int process_cpus[CPU_SETSIZE];  // CPUs of this process, in the order threads are placed on them
+static size_t num_process_cpus = 0;    // 0 if this process is not pinned
+
+/// Reads a small sysfs file.
+/// @return Number of bytes read, -1 if the file could not be read.
+static ssize_t read_sysfs(const char* path, char* text, size_t size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+  ssize_t length = read(fd, text, size - 1);
+  close(fd);
+  if (length >= 0) {
+    text[length] = '\0';
+  }
+  return length;
+}
+
+/// Reads a topology attribute of a CPU.
+/// @param fallback Value returned if the attribute cannot be read.
+static int read_topology(int cpu, const char* name, int fallback) {
+  char path[128], text[32];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+  if (read_sysfs(path, text, sizeof(text)) <= 0) return fallback;
+
+  char* endptr;
+  long value = strtol(text, &endptr, 10);
+  return endptr == text ? fallback : (int)value;
+}
+
+static int compare_cpus(const void* a, const void* b) {
+  const struct Cpu* x = a;
+  const struct Cpu* y = b;
+  if (x->package != y->package) return x->package < y->package ? -1 : 1;
+  if (x->core != y->core) return x->core < y->core ? -1 : 1;
+  return (x->id > y->id) - (x->id < y->id);
+}
+
+static int compare_by_sibling(const void* a, const void* b) {
+  const struct Cpu* x = a;
+  const struct Cpu* y = b;
+  if (x->sibling != y->sibling) return x->sibling < y->sibling ? -1 : 1;
+  return compare_cpus(a, b);
+}
+
+int affinity_init() {
+  // A list of ranges, such as "0-3,8-11".
+  char text[4096];
+  if (read_sysfs("/sys/devices/system/cpu/online", text, sizeof(text)) <= 0) {
+    fprintf(stderr, "Error reading online CPUs\n");
+    return 1;
+  }
+
+  num_cpus = 0;
+  for (char* p = text; *p != '\0' && *p != '\n';) {
+    char* endptr;
+    long first = strtol(p, &endptr, 10), last = first;
+    if (endptr == p) break;
+    p = endptr;
+    if (*p == '-') {
+      last = strtol(p + 1, &endptr, 10);
+      p = endptr;
+    }
+    for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE && num_cpus < CPU_SETSIZE; cpu++) {
+      cpus[num_cpus].id = (int)cpu;
+      cpus[num_cpus].package = read_topology((int)cpu, "physical_package_id", 0);
+      cpus[num_cpus].core = read_topology((int)cpu, "core_id", (int)cpu);
+      num_cpus++;
+    }
+    if (*p == ',') p++;
+  }
+  if (num_cpus == 0) {
+    fprintf(stderr, "Error reading online CPUs\n");
+    return 1;
+  }
+
+  qsort(cpus, num_cpus, sizeof(struct Cpu), compare_cpus);
+  for (size_t i = 0; i < num_cpus; i++) {
+    int same_core = i > 0 && cpus[i].package == cpus[i - 1].package && cpus[i].core == cpus[i - 1].core;
+    cpus[i].sibling = same_core ? cpus[i - 1].sibling + 1 : 0;
+  }
+  return 0;
+}
+
+/// Gets the CPUs of a process slot, in the order threads are placed on them.
+/// @param cpu_ids Array to store the CPU ids in, of at least CPU_SETSIZE elements.
+/// @return Number of CPUs of the slot.
+static size_t slot_cpus(unsigned int slot, unsigned int num_slots, int* cpu_ids) {
+  struct Cpu set[CPU_SETSIZE];
+  size_t count;
+  if (num_slots >= num_cpus) {
+    // More processes than CPUs: one CPU each, shared round robin.
+    set[0] = cpus[slot % num_cpus];
+    count = 1;
+  } else {
+    size_t first = slot * num_cpus / num_slots, end = (slot + 1) * num_cpus / num_slots;
+    count = end - first;
+    for (size_t i = 0; i < count; i++) {
+      set[i] = cpus[first + i];
+    }
+  }
+
+  // One thread per core first, then the remaining hyperthreads.
+  qsort(set, count, sizeof(struct Cpu), compare_by_sibling);
+  for (size_t i = 0; i < count; i++) {
+    cpu_ids[i] = set[i].id;
+  }
+  return count;
+}
+
+int affinity_pin_process(unsigned int slot, unsigned int num_slots) {
+  if (num_cpus == 0) return 1;
+
+  num_process_cpus = slot_cpus(slot, num_slots, process_cpus);
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for (size_t i = 0; i < num_process_cpus; i++) {
+    CPU_SET((size_t)process_cpus[i], &mask);
+  }
+  if (sched_setaffinity(0, sizeof(mask), &mask) != 0) {
+    perror("Error pinning process");
+    num_process_cpus = 0;
+    return 1;
+  }
+  return 0;
+}
+
+int affinity_pin_thread(unsigned int thread_index) {
+  if (num_process_cpus == 0) return 0;
+
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET((size_t)process_cpus[thread_index % num_process_cpus], &mask);
+  int error = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+  if (error != 0) {
+    fprintf(stderr, "Error pinning thread: error %d\n", error);
+    return 1;
+  }
+  return 0;
+}
+
+void affinity_report(unsigned int num_slots, unsigned int num_threads) {
+  size_t num_cores = 0;
+  int num_packages = 0;
+  for (size_t i = 0; i < num_cpus; i++) {
+    num_cores += cpus[i].sibling == 0;
+    num_packages += i == 0 || cpus[i].package != cpus[i - 1].package;
+  }
+  printf("Placement over %zu CPUs (%zu cores, %d packages):\n", num_cpus, num_cores, num_packages);
+
+  int cpu_ids[CPU_SETSIZE];
+  for (unsigned int slot = 0; slot < num_slots; slot++) {
+    size_t count = slot_cpus(slot, num_slots, cpu_ids);
+    printf("  process %u: CPUs", slot + 1);
+    for (size_t i = 0; i < count; i++) {
+      printf(" %d", cpu_ids[i]);
+    }
+    printf("; threads");
+    for (unsigned int thread = 0; thread < num_threads; thread++) {
+      printf(" %u->%d", thread + 1, cpu_ids[thread % count]);
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
@@ -0,0 +1,28 @@
+#ifndef EMS_AFFINITY_H
+#define EMS_AFFINITY_H
+
+/// Reads the CPU topology from /sys/devices/system/cpu.
+/// @note CPUs whose topology cannot be read are taken as cores of their own.
+/// @return 0 if the online CPUs were read successfully, 1 otherwise.
+int affinity_init();
+
+/// Pins the calling process to the CPUs of a process slot. The online CPUs, ordered by package and core,
+/// are split into as many contiguous sets as there are slots, so that a process keeps to one package and
+/// hyperthreads of a core stay in the same process.
+/// @param slot Slot of the process, from 0 to num_slots - 1.
+/// @param num_slots Number of processes running at the same time.
+/// @return 0 if the process was pinned successfully, 1 otherwise.
+int affinity_pin_process(unsigned int slot, unsigned int num_slots);
+
+/// Pins the calling thread to one CPU of its process, spreading threads over distinct cores before
+/// sharing a core between hyperthreads. Does nothing if the process was not pinned.
+/// @param thread_index Index of the thread within its process.
+/// @return 0 if the thread was pinned successfully (or pinning is off), 1 otherwise.
+int affinity_pin_thread(unsigned int thread_index);
+
+/// Prints the topology read and the placement of every process slot and thread.
+/// @param num_slots Number of processes running at the same time.
+/// @param num_threads Number of threads of each process.
+void affinity_report(unsigned int num_slots, unsigned int num_threads);
+
+#endif  // EMS_AFFINITY_H
@@ -0,0 +1,290 @@
+#define _DEFAULT_SOURCE  // wait4
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_VALUES 32       // Values of each swept parameter
+#define MAX_EXTRA_OPTIONS 16
+#define DEFAULT_REPEATS 3
+
+// Values a parameter is swept over.
+struct Sweep {
+  unsigned int values[MAX_VALUES];
+  size_t count;
+};
+
+// What one run of ems used, as reported by wait4 for ems and the processes it waited for.
+struct Measure {
+  double wall_s;
+  double user_s;
+  double sys_s;
+  long max_rss_kb;
+  long voluntary_switches;
+  long involuntary_switches;
+  int status;  // Exit status of ems, or 128 plus the signal that killed it
+};
+
+/// Parses a comma separated list of unsigned integers, such as "1,2,4,8".
+/// @return 0 if the list was parsed successfully, 1 otherwise.
+static int parse_sweep(const char* text, struct Sweep* sweep) {
+  sweep->count = 0;
+  const char* p = text;
+  while (1) {
+    char* endptr;
+    errno = 0;
+    unsigned long value = strtoul(p, &endptr, 10);
+    if (endptr == p || errno != 0 || value > UINT_MAX || sweep->count == MAX_VALUES) return 1;
+    sweep->values[sweep->count++] = (unsigned int)value;
+    if (*endptr == '\0') return 0;
+    if (*endptr != ',') return 1;
+    p = endptr + 1;
+  }
+}
+
+/// Copies the job files of the corpus to the working directory, so that ems writes its outputs there.
+/// @param num_commands Pointer to the variable to store the number of commands (non-empty lines) in.
+/// @return Number of job files copied, -1 on error.
+static int copy_corpus(const char* corpus, const char* directory, unsigned long* num_commands) {
+  DIR* dir = opendir(corpus);
+  if (dir == NULL) {
+    fprintf(stderr, "Error opening %s: %s\n", corpus, strerror(errno));
+    return -1;
+  }
+
+  int num_files = 0;
+  *num_commands = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t length = strlen(entry->d_name);
+    if (length < 5 || strcmp(entry->d_name + length - 5, ".jobs") != 0) continue;
+
+    char source_path[4096], target_path[4096];
+    snprintf(source_path, sizeof(source_path), "%s/%s", corpus, entry->d_name);
+    snprintf(target_path, sizeof(target_path), "%s/%s", directory, entry->d_name);
+    FILE* source = fopen(source_path, "r");
+    FILE* target = fopen(target_path, "w");
+    if (source == NULL || target == NULL) {
+      fprintf(stderr, "Error copying %s: %s\n", source_path, strerror(errno));
+      if (source != NULL) fclose(source);
+      if (target != NULL) fclose(target);
+      closedir(dir);
+      return -1;
+    }
+
+    int c, previous = '\n';
+    while ((c = fgetc(source)) != EOF) {
+      fputc(c, target);
+      *num_commands += c == '\n' && previous != '\n';
+      previous = c;
+    }
+    *num_commands += previous != '\n';
+    fclose(source);
+    if (fclose(target) != 0) {
+      fprintf(stderr, "Error writing %s: %s\n", target_path, strerror(errno));
+      closedir(dir);
+      return -1;
+    }
+    num_files++;
+  }
+  closedir(dir);
+  return num_files;
+}
+
+/// Runs ems to completion, discarding what it prints.
+/// @param argv Command line of ems, NULL terminated.
+/// @param measure Pointer to the measure to store what the run used in.
+/// @return 0 if ems was run and waited for, 1 otherwise.
+static int run_measured(char* const argv[], struct Measure* measure) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("Error forking");
+    return 1;
+  }
+  if (pid == 0) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDOUT_FILENO);
+      dup2(null_fd, STDERR_FILENO);
+    }
+    execv(argv[0], argv);
+    _exit(127);
+  }
+
+  // The usage wait4 reports covers ems and every process it waited for, that is, its job processes.
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    perror("Error waiting for ems");
+    return 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  measure->wall_s = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  measure->user_s = (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1e6;
+  measure->sys_s = (double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1e6;
+  measure->max_rss_kb = usage.ru_maxrss;
+  measure->voluntary_switches = usage.ru_nvcsw;
+  measure->involuntary_switches = usage.ru_nivcsw;
+  measure->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  return 0;
+}
+
+/// Removes the working directory and the files in it.
+static void remove_directory(const char* directory) {
+  DIR* dir = opendir(directory);
+  if (dir == NULL) return;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+    unlink(path);
+  }
+  closedir(dir);
+  rmdir(directory);
+}
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [-P processes] [-T threads] [-D delays] [-r repeats] [-o output.csv] <ems> <jobs_directory> "
+          "[ems options]...\n"
+          "       Runs ems over the job files of jobs_directory for every combination of the comma separated\n"
+          "       numbers of processes, threads and delays, and writes what each run used as CSV.\n",
+          program);
+}
+
+int main(int argc, char* argv[]) {
+  struct Sweep processes = {{1, 2, 4}, 3}, threads = {{1, 2, 4, 8}, 4}, delays = {{0, 1, 10}, 3};
+  unsigned int repeats = DEFAULT_REPEATS;
+  const char* output_path = NULL;
+  int opt;
+  // "+" stops at the first operand, leaving the options that follow it for ems.
+  while ((opt = getopt(argc, argv, "+P:T:D:r:o:")) != -1) {
+    int invalid = 0;
+    switch (opt) {
+      case 'P':
+        invalid = parse_sweep(optarg, &processes);
+        break;
+      case 'T':
+        invalid = parse_sweep(optarg, &threads);
+        break;
+      case 'D':
+        invalid = parse_sweep(optarg, &delays);
+        break;
+      case 'r': {
+        char* endptr;
+        unsigned long value = strtoul(optarg, &endptr, 10);
+        invalid = *optarg == '\0' || *endptr != '\0' || value == 0 || value > UINT_MAX;
+        repeats = (unsigned int)value;
+        break;
+      }
+      case 'o':
+        output_path = optarg;
+        break;
+      default:
+        invalid = 1;
+        break;
+    }
+    if (invalid) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  int num_extra_options = argc - optind - 2;
+  if (num_extra_options < 0 || num_extra_options > MAX_EXTRA_OPTIONS) {
+    usage(argv[0]);
+    return 1;
+  }
+  for (size_t i = 0; i < processes.count; i++) {
+    for (size_t j = 0; j < threads.count; j++) {
+      if (processes.values[i] == 0 || threads.values[j] == 0) {
+        fprintf(stderr, "Numbers of processes and threads must be positive\n");
+        return 1;
+      }
+    }
+  }
+  char* ems = argv[optind];
+  const char* corpus = argv[optind + 1];
+
+  FILE* output = stdout;
+  if (output_path != NULL && (output = fopen(output_path, "w")) == NULL) {
+    fprintf(stderr, "Error creating %s: %s\n", output_path, strerror(errno));
+    return 1;
+  }
+
+  char directory[] = "/tmp/ems-bench-XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    perror("Error creating working directory");
+    return 1;
+  }
+  unsigned long num_commands;
+  int num_files = copy_corpus(corpus, directory, &num_commands);
+  if (num_files <= 0) {
+    if (num_files == 0) {
+      fprintf(stderr, "No job files in %s\n", corpus);
+    }
+    remove_directory(directory);
+    return 1;
+  }
+
+  // ems [options] <directory> <max_processes> <max_threads> <delay>
+  char process_text[16], thread_text[16], delay_text[16];
+  char* ems_argv[MAX_EXTRA_OPTIONS + 6];
+  int ems_argc = 0;
+  ems_argv[ems_argc++] = ems;
+  for (int i = 0; i < num_extra_options; i++) {
+    ems_argv[ems_argc++] = argv[optind + 2 + i];
+  }
+  ems_argv[ems_argc++] = directory;
+  ems_argv[ems_argc++] = process_text;
+  ems_argv[ems_argc++] = thread_text;
+  ems_argv[ems_argc++] = delay_text;
+  ems_argv[ems_argc] = NULL;
+
+  fprintf(output,
+          "processes,threads,delay_ms,repeat,job_files,commands,wall_s,user_s,sys_s,max_rss_kb,"
+          "voluntary_switches,involuntary_switches,commands_per_s,status\n");
+  int failed = 0;
+  for (size_t d = 0; d < delays.count; d++) {
+    for (size_t p = 0; p < processes.count; p++) {
+      for (size_t t = 0; t < threads.count; t++) {
+        snprintf(process_text, sizeof(process_text), "%u", processes.values[p]);
+        snprintf(thread_text, sizeof(thread_text), "%u", threads.values[t]);
+        snprintf(delay_text, sizeof(delay_text), "%u", delays.values[d]);
+        for (unsigned int repeat = 1; repeat <= repeats; repeat++) {
+          struct Measure measure;
+          if (run_measured(ems_argv, &measure) != 0) {
+            failed = 1;
+            break;
+          }
+          fprintf(output, "%u,%u,%u,%u,%d,%lu,%.6f,%.6f,%.6f,%ld,%ld,%ld,%.1f,%d\n", processes.values[p],
+                  threads.values[t], delays.values[d], repeat, num_files, num_commands, measure.wall_s,
+                  measure.user_s, measure.sys_s, measure.max_rss_kb, measure.voluntary_switches,
+                  measure.involuntary_switches, (double)num_commands / measure.wall_s, measure.status);
+          fflush(output);
+          failed |= measure.status != 0;
+        }
+      }
+    }
+  }
+
+  remove_directory(directory);
+  if (output != stdout && fclose(output) != 0) {
+    fprintf(stderr, "Error writing %s: %s\n", output_path, strerror(errno));
+    return 1;
+  }
+  return failed;
+}
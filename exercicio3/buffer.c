@@ -0,0 +1,100 @@
+#include "buffer.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUFFER_PAGE_SIZE 4096
+
+void buffer_init(struct Buffer* buffer) {
+  buffer->data = NULL;
+  buffer->len = 0;
+  buffer->capacity = 0;
+}
+
+static int buffer_reserve(struct Buffer* buffer, size_t extra) {
+  if (buffer->len + extra <= buffer->capacity) return 0;
+
+  size_t capacity = buffer->capacity ? buffer->capacity : 64;
+  while (capacity < buffer->len + extra) {
+    capacity *= 2;
+  }
+
+  // Buffers of a page or more start on a page boundary, so that their pages can be spliced whole.
+  char* data;
+  if (capacity >= BUFFER_PAGE_SIZE) {
+    capacity = (capacity + BUFFER_PAGE_SIZE - 1) & ~(size_t)(BUFFER_PAGE_SIZE - 1);
+    data = aligned_alloc(BUFFER_PAGE_SIZE, capacity);
+    if (!data) return 1;
+    if (buffer->len > 0) {
+      memcpy(data, buffer->data, buffer->len);
+    }
+    free(buffer->data);
+  } else {
+    data = realloc(buffer->data, capacity);
+    if (!data) return 1;
+  }
+
+  buffer->data = data;
+  buffer->capacity = capacity;
+  return 0;
+}
+
+int buffer_append(struct Buffer* buffer, const char* data, size_t len) {
+  if (len == 0) return 0;
+  if (buffer_reserve(buffer, len) != 0) return 1;
+
+  memcpy(buffer->data + buffer->len, data, len);
+  buffer->len += len;
+  return 0;
+}
+
+int buffer_append_uint(struct Buffer* buffer, unsigned int value) {
+  char digits[10];
+  size_t n = 0;
+
+  do {
+    digits[sizeof(digits) - ++n] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+
+  return buffer_append(buffer, digits + sizeof(digits) - n, n);
+}
+
+void buffer_free(struct Buffer* buffer) {
+  free(buffer->data);
+  buffer_init(buffer);
+}
+
+int write_all(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(fd, data, len);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return 1;
+    }
+
+    data += written;
+    len -= (size_t)written;
+  }
+
+  return 0;
+}
+
+int read_all(int fd, void* data, size_t len) {
+  char* bytes = data;
+  while (len > 0) {
+    ssize_t bytes_read = read(fd, bytes, len);
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      return 1;
+    }
+    if (bytes_read == 0) return 1;
+
+    bytes += bytes_read;
+    len -= (size_t)bytes_read;
+  }
+
+  return 0;
+}
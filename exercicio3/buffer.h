@@ -0,0 +1,48 @@
+#ifndef EMS_BUFFER_H
+#define EMS_BUFFER_H
+
+#include <stddef.h>
+
+// Growable byte buffer used to render output before writing it.
+struct Buffer {
+  char* data;       // Buffer contents (not null terminated)
+  size_t len;       // Number of bytes in use
+  size_t capacity;  // Number of bytes allocated
+};
+
+/// Initializes an empty buffer.
+/// @param buffer Buffer to be initialized.
+void buffer_init(struct Buffer* buffer);
+
+/// Appends bytes to the buffer, growing it if needed.
+/// @param buffer Buffer to be modified.
+/// @param data Bytes to append.
+/// @param len Number of bytes to append.
+/// @return 0 if the bytes were appended successfully, 1 otherwise.
+int buffer_append(struct Buffer* buffer, const char* data, size_t len);
+
+/// Appends the decimal representation of an unsigned integer to the buffer.
+/// @param buffer Buffer to be modified.
+/// @param value Value to append.
+/// @return 0 if the value was appended successfully, 1 otherwise.
+int buffer_append_uint(struct Buffer* buffer, unsigned int value);
+
+/// Frees the memory held by the buffer and leaves it empty.
+/// @param buffer Buffer to be freed.
+void buffer_free(struct Buffer* buffer);
+
+/// Writes the whole contents of a byte range to a file descriptor.
+/// @param fd File descriptor to write to.
+/// @param data Bytes to write.
+/// @param len Number of bytes to write.
+/// @return 0 if everything was written, 1 otherwise.
+int write_all(int fd, const char* data, size_t len);
+
+/// Reads exactly len bytes from a file descriptor.
+/// @param fd File descriptor to read from.
+/// @param data Array to store the bytes in.
+/// @param len Number of bytes to read.
+/// @return 0 if everything was read, 1 on error or end of file.
+int read_all(int fd, void* data, size_t len);
+
+#endif  // EMS_BUFFER_H
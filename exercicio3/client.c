@@ -0,0 +1,194 @@
+#include "client.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "protocol.h"
+
+static pthread_mutex_t name_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int sessions_opened = 0;  // Makes the FIFO names of a process unique
+
+int client_connect(const char* registration_path, struct Session* session) {
+  struct Registration registration;
+  memset(&registration, 0, sizeof(registration));
+  session->next_sequence = 0;
+
+  pthread_mutex_lock(&name_mutex);
+  unsigned int number = sessions_opened++;
+  pthread_mutex_unlock(&name_mutex);
+  snprintf(registration.request_path, MAX_PIPE_PATH_LEN, "/tmp/ems_%d_%u.req", getpid(), number);
+  snprintf(registration.response_path, MAX_PIPE_PATH_LEN, "/tmp/ems_%d_%u.resp", getpid(), number);
+
+  if (mkfifo(registration.request_path, S_IRUSR | S_IWUSR) != 0 ||
+      mkfifo(registration.response_path, S_IRUSR | S_IWUSR) != 0) {
+    perror("Error creating session pipes");
+    unlink(registration.request_path);
+    return 1;
+  }
+
+  // Opened before registering so that the server never blocks opening it.
+  session->response_fd = open(registration.response_path, O_RDONLY | O_NONBLOCK);
+  int registration_fd = open(registration_path, O_WRONLY);
+  int result = session->response_fd < 0 || registration_fd < 0 ||
+               write_all(registration_fd, (const char*)&registration, sizeof(registration)) != 0;
+  if (registration_fd >= 0) {
+    close(registration_fd);
+  }
+
+  // Blocks until the server has opened both pipes.
+  session->request_fd = result == 0 ? open(registration.request_path, O_WRONLY) : -1;
+  if (session->request_fd < 0 || fcntl(session->response_fd, F_SETFL, 0) != 0) {
+    perror("Error connecting to server");
+    result = 1;
+  }
+
+  unlink(registration.request_path);
+  unlink(registration.response_path);
+
+  if (result != 0) {
+    if (session->response_fd >= 0) close(session->response_fd);
+    if (session->request_fd >= 0) close(session->request_fd);
+  }
+  return result;
+}
+
+void client_disconnect(struct Session* session) {
+  close(session->request_fd);
+  close(session->response_fd);
+}
+
+int client_send(struct Session* session, enum RequestType type, const uint32_t* fields, size_t num_fields,
+                uint32_t* sequence) {
+  struct RequestHeader request = {session->next_sequence, (uint32_t)type, (uint32_t)num_fields};
+
+  // A single write, so that the server gets the whole request at once.
+  char message[sizeof(request) + MAX_REQUEST_FIELDS * sizeof(uint32_t)];
+  if (num_fields > MAX_REQUEST_FIELDS) return 1;
+  memcpy(message, &request, sizeof(request));
+  if (num_fields > 0) {
+    memcpy(message + sizeof(request), fields, num_fields * sizeof(uint32_t));
+  }
+  if (write_all(session->request_fd, message, sizeof(request) + num_fields * sizeof(uint32_t)) != 0) {
+    fprintf(stderr, "Lost connection to server\n");
+    return 1;
+  }
+
+  *sequence = session->next_sequence++;
+  return 0;
+}
+
+int client_receive(struct Session* session, uint32_t* sequence, int* status, struct Buffer* output) {
+  struct ResponseHeader response;
+  if (read_all(session->response_fd, &response, sizeof(response)) != 0) {
+    fprintf(stderr, "Lost connection to server\n");
+    return 1;
+  }
+
+  *sequence = response.sequence;
+  *status = response.status != 0;
+
+  char chunk[4096];
+  for (size_t remaining = response.length; remaining > 0;) {
+    size_t size = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+    if (read_all(session->response_fd, chunk, size) != 0) {
+      fprintf(stderr, "Lost connection to server\n");
+      return 1;
+    }
+    if (output != NULL && buffer_append(output, chunk, size) != 0) {
+      *status = 1;
+    }
+    remaining -= size;
+  }
+
+  return 0;
+}
+
+/// Sends a request and waits for its response.
+/// @param session Session to send the request through, with no other request outstanding.
+/// @param type Type of the request.
+/// @param fields Fields of the request.
+/// @param num_fields Number of fields.
+/// @param output Buffer to append the output of the request to, NULL if it has none.
+/// @return 0 if the operation succeeded, 1 otherwise.
+static int call(struct Session* session, enum RequestType type, const uint32_t* fields, size_t num_fields,
+                struct Buffer* output) {
+  uint32_t sent, answered;
+  int status;
+  if (client_send(session, type, fields, num_fields, &sent) != 0 ||
+      client_receive(session, &answered, &status, output) != 0) {
+    return 1;
+  }
+  if (answered != sent) {
+    fprintf(stderr, "Unexpected response from server\n");
+    return 1;
+  }
+  return status;
+}
+
+int client_create(struct Session* session, unsigned int event_id, size_t num_rows, size_t num_cols) {
+  uint32_t fields[3] = {event_id, (uint32_t)num_rows, (uint32_t)num_cols};
+  return call(session, REQUEST_CREATE, fields, 3, NULL);
+}
+
+int client_reserve(struct Session* session, unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  uint32_t fields[2 + 2 * MAX_RESERVATION_SIZE];
+  size_t num_fields = protocol_encode_reservation(fields, event_id, num_seats, xs, ys);
+  return call(session, REQUEST_RESERVE, fields, num_fields, NULL);
+}
+
+int client_reserve_multi(struct Session* session, size_t num_events, unsigned int* event_ids, size_t* num_seats,
+                         size_t* xs, size_t* ys) {
+  uint32_t fields[MAX_REQUEST_FIELDS];
+  size_t n = 0, offset = 0;
+  fields[n++] = (uint32_t)num_events;
+  for (size_t i = 0; i < num_events; i++) {
+    n += protocol_encode_reservation(fields + n, event_ids[i], num_seats[i], xs + offset, ys + offset);
+    offset += num_seats[i];
+  }
+  return call(session, REQUEST_RESERVE_MULTI, fields, n, NULL);
+}
+
+int client_reserve_best(struct Session* session, unsigned int event_id, size_t num_seats, int contiguous) {
+  uint32_t fields[3] = {event_id, (uint32_t)num_seats, contiguous != 0};
+  return call(session, REQUEST_RESERVE_BEST, fields, 3, NULL);
+}
+
+int client_show(struct Session* session, unsigned int event_id, struct Buffer* output) {
+  uint32_t fields[1] = {event_id};
+  return call(session, REQUEST_SHOW, fields, 1, output);
+}
+
+int client_show_bin(struct Session* session, unsigned int event_id, struct Buffer* output) {
+  uint32_t fields[1] = {event_id};
+  return call(session, REQUEST_SHOW_BIN, fields, 1, output);
+}
+
+int client_query(struct Session* session, unsigned int event_id, unsigned int reservation_id, struct Buffer* output) {
+  uint32_t fields[2] = {event_id, reservation_id};
+  return call(session, REQUEST_QUERY, fields, 2, output);
+}
+
+int client_cancel(struct Session* session, unsigned int event_id, unsigned int reservation_id) {
+  uint32_t fields[2] = {event_id, reservation_id};
+  return call(session, REQUEST_CANCEL, fields, 2, NULL);
+}
+
+int client_delete(struct Session* session, unsigned int event_id) {
+  uint32_t fields[1] = {event_id};
+  return call(session, REQUEST_DELETE, fields, 1, NULL);
+}
+
+int client_list_events(struct Session* session, struct Buffer* output) {
+  return call(session, REQUEST_LIST, NULL, 0, output);
+}
+
+int client_mem_stats(struct Session* session, struct Buffer* output) {
+  return call(session, REQUEST_STATS_MEM, NULL, 0, output);
+}
@@ -0,0 +1,81 @@
+#ifndef EMS_CLIENT_H
+#define EMS_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffer.h"
+#include "protocol.h"
+
+// Connection of a client to the EMS server.
+struct Session {
+  int request_fd;          // FIFO requests are written to
+  int response_fd;         // FIFO responses are read from
+  uint32_t next_sequence;  // Sequence number of the next request
+};
+
+/// Registers with the server and opens a new session.
+/// @param registration_path Path of the server's registration FIFO.
+/// @param session Session to be opened.
+/// @return 0 if the session was opened successfully, 1 otherwise.
+int client_connect(const char* registration_path, struct Session* session);
+
+/// Closes a session. The server drops it once its requests are answered.
+/// @param session Session to be closed.
+void client_disconnect(struct Session* session);
+
+/// Sends a request without waiting for its response.
+/// @note Responses must be read as they come: a client that stops reading eventually blocks the server's
+/// writes, and then its own.
+/// @param session Session to send the request through.
+/// @param type Type of the request.
+/// @param fields Fields of the request, see enum RequestType.
+/// @param num_fields Number of fields.
+/// @param sequence Pointer to the variable to store the sequence number of the request in.
+/// @return 0 if the request was sent, 1 otherwise.
+int client_send(struct Session* session, enum RequestType type, const uint32_t* fields, size_t num_fields,
+                uint32_t* sequence);
+
+/// Reads the next response of a session, which may answer any outstanding request.
+/// @param session Session to read from.
+/// @param sequence Pointer to the variable to store the sequence number of the request answered in.
+/// @param status Pointer to the variable to store whether the operation failed in.
+/// @param output Buffer to append the output of the request to, NULL to discard it.
+/// @return 0 if a response was read, 1 if the connection was lost.
+int client_receive(struct Session* session, uint32_t* sequence, int* status, struct Buffer* output);
+
+/// Same as ems_create, executed by the server.
+int client_create(struct Session* session, unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Same as ems_reserve, executed by the server.
+int client_reserve(struct Session* session, unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
+
+/// Same as ems_reserve_multi, executed by the server.
+int client_reserve_multi(struct Session* session, size_t num_events, unsigned int* event_ids, size_t* num_seats,
+                         size_t* xs, size_t* ys);
+
+/// Same as ems_reserve_best, executed by the server.
+int client_reserve_best(struct Session* session, unsigned int event_id, size_t num_seats, int contiguous);
+
+/// Same as ems_render_show, executed by the server.
+int client_show(struct Session* session, unsigned int event_id, struct Buffer* output);
+
+/// Same as ems_render_show_bin, executed by the server.
+int client_show_bin(struct Session* session, unsigned int event_id, struct Buffer* output);
+
+/// Same as ems_render_query, executed by the server.
+int client_query(struct Session* session, unsigned int event_id, unsigned int reservation_id, struct Buffer* output);
+
+/// Same as ems_cancel, executed by the server.
+int client_cancel(struct Session* session, unsigned int event_id, unsigned int reservation_id);
+
+/// Same as ems_delete, executed by the server.
+int client_delete(struct Session* session, unsigned int event_id);
+
+/// Same as ems_render_list_events, executed by the server.
+int client_list_events(struct Session* session, struct Buffer* output);
+
+/// Same as ems_render_mem_stats, executed by the server.
+int client_mem_stats(struct Session* session, struct Buffer* output);
+
+#endif  // EMS_CLIENT_H
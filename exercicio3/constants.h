@@ -1,2 +1,16 @@
 #define MAX_RESERVATION_SIZE 256
 #define STATE_ACCESS_DELAY_MS 10
+#define SPARSE_SEAT_THRESHOLD (1 << 22)
+#define MAX_MULTI_EVENTS 16
+#define WAL_FLUSH_INTERVAL_MS 5
+#define CHECKPOINT_INTERVAL_RECORDS 4096
+#define PARALLEL_SHOW_THRESHOLD (1 << 14)
+#define SHOW_SLICES_PER_THREAD 4
+#define AUTO_CPU_US_PER_ACCESS 50
+#define AUTO_MAX_OVERSUBSCRIPTION 64
+#define AUTO_BYTES_PER_COMMAND 16
+#define SEQUENCER_WINDOW 4096
+#define PIPELINE_DEPTH 64
+#define MAX_RESERVE_BATCH 64
+#define OUTPUT_SPLICE_MIN_BYTES (1 << 16)
+#define OUTPUT_PIPE_SIZE (1 << 20)
@@ -0,0 +1,136 @@
+#include "epoch.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Critical section state of a thread. Records are never freed: a record released by an exiting thread
+// is taken over by the next thread that needs one.
+struct EpochRecord {
+  atomic_uint_fast64_t epoch;  // Global epoch seen when the critical section was entered, 0 outside
+  unsigned int depth;          // Nesting of critical sections, only touched by the owner
+  atomic_int in_use;
+  struct EpochRecord* next;
+};
+
+// Memory waiting for the readers that may see it to leave.
+struct Retired {
+  void* ptr;
+  epoch_free_fn free_fn;
+  uint_fast64_t epoch;  // Global epoch when it was retired
+  struct Retired* next;
+};
+
+static atomic_uint_fast64_t global_epoch = 1;
+static _Atomic(struct EpochRecord*) records = NULL;
+static _Thread_local struct EpochRecord* local_record = NULL;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t record_key;  // Releases the record of a thread when it exits
+
+static pthread_mutex_t retired_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct Retired* retired = NULL;  // Newest first
+
+static void release_record(void* record) {
+  atomic_store_explicit(&((struct EpochRecord*)record)->in_use, 0, memory_order_release);
+}
+
+static void create_key() { pthread_key_create(&record_key, release_record); }
+
+/// Gets the record of the calling thread, taking over a released one or adding a new one.
+static struct EpochRecord* thread_record() {
+  if (local_record != NULL) return local_record;
+
+  struct EpochRecord* record = atomic_load_explicit(&records, memory_order_acquire);
+  for (; record != NULL; record = record->next) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&record->in_use, &expected, 1)) break;
+  }
+  if (record == NULL) {
+    record = malloc(sizeof(struct EpochRecord));
+    if (record == NULL) {
+      fprintf(stderr, "Error allocating memory for epoch record\n");
+      abort();
+    }
+    atomic_init(&record->epoch, 0);
+    atomic_init(&record->in_use, 1);
+    record->next = atomic_load_explicit(&records, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak(&records, &record->next, record)) {
+    }
+  }
+  record->depth = 0;
+
+  pthread_once(&key_once, create_key);
+  pthread_setspecific(record_key, record);
+  local_record = record;
+  return record;
+}
+
+void epoch_enter() {
+  struct EpochRecord* record = thread_record();
+  if (record->depth++ > 0) return;
+  // Sequentially consistent, so that the epoch is announced before any shared pointer is read.
+  atomic_store(&record->epoch, atomic_load(&global_epoch));
+}
+
+void epoch_exit() {
+  struct EpochRecord* record = local_record;
+  if (--record->depth > 0) return;
+  atomic_store_explicit(&record->epoch, 0, memory_order_release);
+}
+
+/// Moves the global epoch forward if every thread in a critical section has seen the current one.
+/// @return The global epoch.
+static uint_fast64_t try_advance() {
+  uint_fast64_t epoch = atomic_load(&global_epoch);
+  for (struct EpochRecord* record = atomic_load(&records); record != NULL; record = record->next) {
+    uint_fast64_t seen = atomic_load(&record->epoch);
+    if (seen != 0 && seen != epoch) return epoch;
+  }
+  atomic_compare_exchange_strong(&global_epoch, &epoch, epoch + 1);
+  return atomic_load(&global_epoch);
+}
+
+void epoch_retire(void* ptr, epoch_free_fn free_fn) {
+  struct Retired* entry = malloc(sizeof(struct Retired));
+  if (entry == NULL) {
+    fprintf(stderr, "Error allocating memory for retired memory\n");
+    abort();
+  }
+  entry->ptr = ptr;
+  entry->free_fn = free_fn;
+
+  pthread_mutex_lock(&retired_mutex);
+  entry->epoch = atomic_load(&global_epoch);
+  entry->next = retired;
+  retired = entry;
+
+  // A reader that saw the memory entered at the retiring epoch or the one before, so it has left once
+  // the global epoch is two past it.
+  uint_fast64_t epoch = try_advance();
+  struct Retired** link = &retired;
+  while (*link != NULL) {
+    struct Retired* candidate = *link;
+    if (candidate->epoch + 2 <= epoch) {
+      *link = candidate->next;
+      candidate->free_fn(candidate->ptr);
+      free(candidate);
+    } else {
+      link = &candidate->next;
+    }
+  }
+  pthread_mutex_unlock(&retired_mutex);
+}
+
+void epoch_drain() {
+  pthread_mutex_lock(&retired_mutex);
+  while (retired != NULL) {
+    struct Retired* entry = retired;
+    retired = entry->next;
+    entry->free_fn(entry->ptr);
+    free(entry);
+  }
+  pthread_mutex_unlock(&retired_mutex);
+}
@@ -0,0 +1,25 @@
+#ifndef EMS_EPOCH_H
+#define EMS_EPOCH_H
+
+/// Function freeing memory retired with epoch_retire.
+typedef void (*epoch_free_fn)(void* ptr);
+
+/// Enters a read-side critical section: memory retired from now on is not freed until the calling thread
+/// leaves it. Critical sections nest, only the outermost one counts.
+void epoch_enter();
+
+/// Leaves a read-side critical section entered with epoch_enter.
+void epoch_exit();
+
+/// Frees memory once no thread can still be reading it, that is, once every thread that was in a
+/// critical section when it was retired has left it.
+/// @note The memory must already be unreachable for threads entering a critical section.
+/// @param ptr Memory to be freed.
+/// @param free_fn Function freeing it.
+void epoch_retire(void* ptr, epoch_free_fn free_fn);
+
+/// Frees every memory retired so far, whatever the critical sections.
+/// @note No thread may be in a critical section.
+void epoch_drain();
+
+#endif  // EMS_EPOCH_H
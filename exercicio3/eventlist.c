@@ -1,24 +1,133 @@
 #include "eventlist.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#include "epoch.h"
+#include "mem.h"
+
+#define INITIAL_BUCKETS 16
+
+/// Spreads event ids over the buckets (Fibonacci hashing).
+static size_t bucket_of(const struct DirectoryTable* table, unsigned int event_id) {
+  return (size_t)((event_id * UINT64_C(11400714819323198485)) >> 32) & table->mask;
+}
+
+static struct DirectoryTable* create_table(size_t num_buckets) {
+  struct DirectoryTable* table =
+      mem_calloc(MEM_LIST, 1, sizeof(struct DirectoryTable) + num_buckets * sizeof(_Atomic(struct DirectoryNode*)));
+  if (!table) return NULL;
+  table->mask = num_buckets - 1;
+  for (size_t i = 0; i < num_buckets; i++) {
+    atomic_init(&table->buckets[i], NULL);
+  }
+  return table;
+}
+
+/// Frees a table and its nodes, not the events.
+static void free_table(void* ptr) {
+  struct DirectoryTable* table = ptr;
+  for (size_t i = 0; i <= table->mask; i++) {
+    struct DirectoryNode* node = atomic_load_explicit(&table->buckets[i], memory_order_relaxed);
+    while (node) {
+      struct DirectoryNode* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+      mem_free(node);
+      node = next;
+    }
+  }
+  mem_free(table);
+}
+
+/// Links a new node at the head of its bucket, where readers see it whole.
+/// @note Must be called with the list locked as writer.
+/// @return 0 if the event was added, 1 on allocation failure.
+static int table_insert(struct DirectoryTable* table, struct Event* event) {
+  struct DirectoryNode* node = mem_malloc(MEM_LIST, sizeof(struct DirectoryNode));
+  if (!node) return 1;
+
+  _Atomic(struct DirectoryNode*)* bucket = &table->buckets[bucket_of(table, event->id)];
+  node->event = event;
+  atomic_init(&node->next, atomic_load_explicit(bucket, memory_order_relaxed));
+  atomic_store_explicit(bucket, node, memory_order_release);
+  return 0;
+}
+
+/// Replaces the table by one with twice the buckets, retiring the old one.
+/// @note Must be called with the list locked as writer.
+/// @return 0 if the table was replaced, 1 on allocation failure.
+static int grow_table(struct EventList* list) {
+  struct DirectoryTable* old = atomic_load_explicit(&list->table, memory_order_relaxed);
+  struct DirectoryTable* table = create_table((old->mask + 1) * 2);
+  if (!table) return 1;
+
+  for (size_t i = 0; i <= old->mask; i++) {
+    struct DirectoryNode* node = atomic_load_explicit(&old->buckets[i], memory_order_relaxed);
+    for (; node; node = atomic_load_explicit(&node->next, memory_order_relaxed)) {
+      if (table_insert(table, node->event) != 0) {
+        free_table(table);
+        return 1;
+      }
+    }
+  }
+
+  // Readers still walking the old table find the same events there.
+  atomic_store_explicit(&list->table, table, memory_order_release);
+  epoch_retire(old, free_table);
+  return 0;
+}
 
 struct EventList* create_list() {
-  struct EventList* list = (struct EventList*)malloc(sizeof(struct EventList));
+  struct EventList* list = (struct EventList*)mem_malloc(MEM_LIST, sizeof(struct EventList));
   if (!list) return NULL;
   list->head = NULL;
   list->tail = NULL;
+  list->size = 0;
+  struct DirectoryTable* table = create_table(INITIAL_BUCKETS);
+  if (!table) {
+    mem_free(list);
+    return NULL;
+  }
+  atomic_init(&list->table, table);
+  if (pthread_rwlock_init(&list->lock, NULL) != 0) {
+    mem_free(table);
+    mem_free(list);
+    return NULL;
+  }
   return list;
 }
 
 int append_to_list(struct EventList* list, struct Event* event) {
   if (!list) return 1;
 
-  struct ListNode* new_node = (struct ListNode*)malloc(sizeof(struct ListNode));
-  if (!new_node) return 1;
+  pthread_rwlock_wrlock(&list->lock);
+
+  // Writers are serialized by the lock, so nothing can be inserted between the check and the insertion.
+  if (get_event(list, event->id) != NULL) {
+    pthread_rwlock_unlock(&list->lock);
+    return 1;
+  }
+
+  struct DirectoryTable* table = atomic_load_explicit(&list->table, memory_order_relaxed);
+  if (list->size > table->mask && grow_table(list) != 0) {
+    pthread_rwlock_unlock(&list->lock);
+    return 1;
+  }
+
+  struct ListNode* new_node = (struct ListNode*)mem_malloc(MEM_LIST, sizeof(struct ListNode));
+  if (!new_node) {
+    pthread_rwlock_unlock(&list->lock);
+    return 1;
+  }
 
   new_node->event = event;
   new_node->next = NULL;
 
+  if (table_insert(atomic_load_explicit(&list->table, memory_order_relaxed), event) != 0) {
+    mem_free(new_node);
+    pthread_rwlock_unlock(&list->lock);
+    return 1;
+  }
+
   if (list->head == NULL) {
     list->head = new_node;
     list->tail = new_node;
@@ -26,15 +135,74 @@ int append_to_list(struct EventList* list, struct Event* event) {
     list->tail->next = new_node;
     list->tail = new_node;
   }
+  list->size++;
 
+  pthread_rwlock_unlock(&list->lock);
   return 0;
 }
 
-static void free_event(struct Event* event) {
+struct Event* remove_from_list(struct EventList* list, unsigned int event_id) {
+  if (!list) return NULL;
+
+  pthread_rwlock_wrlock(&list->lock);
+
+  struct DirectoryTable* table = atomic_load_explicit(&list->table, memory_order_relaxed);
+  _Atomic(struct DirectoryNode*)* link = &table->buckets[bucket_of(table, event_id)];
+  struct DirectoryNode* node = atomic_load_explicit(link, memory_order_relaxed);
+  while (node && node->event->id != event_id) {
+    link = &node->next;
+    node = atomic_load_explicit(link, memory_order_relaxed);
+  }
+  if (!node) {
+    pthread_rwlock_unlock(&list->lock);
+    return NULL;
+  }
+
+  // Readers on the node go on through its next pointer, which is left as it is.
+  struct Event* event = node->event;
+  atomic_store_explicit(link, atomic_load_explicit(&node->next, memory_order_relaxed), memory_order_release);
+  epoch_retire(node, mem_free);
+
+  struct ListNode* previous = NULL;
+  struct ListNode* current = list->head;
+  while (current->event != event) {
+    previous = current;
+    current = current->next;
+  }
+  if (previous) {
+    previous->next = current->next;
+  } else {
+    list->head = current->next;
+  }
+  if (list->tail == current) {
+    list->tail = previous;
+  }
+  mem_free(current);
+  list->size--;
+
+  pthread_rwlock_unlock(&list->lock);
+  return event;
+}
+
+void free_event(struct Event* event) {
   if (!event) return;
 
-  free(event->data);
-  free(event);
+  pthread_mutex_destroy(&event->lock);
+  if (event->sparse_rows) {
+    for (size_t i = 0; i < event->rows; i++) {
+      sparse_row_free(&event->sparse_rows[i]);
+    }
+    mem_free(event->sparse_rows);
+  }
+  for (size_t i = 0; event->reservation_log && i < event->reservations; i++) {
+    mem_free(event->reservation_log[i].seats);
+  }
+  mem_free(event->reservation_log);
+  freerun_free(event->free_runs);
+  if (!event->data_mapped) {
+    mem_free(event->data);
+  }
+  mem_free(event);
 }
 
 void free_list(struct EventList* list) {
@@ -46,23 +214,29 @@ void free_list(struct EventList* list) {
     current = current->next;
 
     free_event(temp->event);
-    free(temp);
+    mem_free(temp);
   }
 
-  free(list);
+  pthread_rwlock_destroy(&list->lock);
+  free_table(atomic_load_explicit(&list->table, memory_order_relaxed));
+  mem_free(list);
 }
 
 struct Event* get_event(struct EventList* list, unsigned int event_id) {
   if (!list) return NULL;
 
-  struct ListNode* current = list->head;
-  while (current) {
-    struct Event* event = current->event;
-    if (event->id == event_id) {
-      return event;
+  struct Event* event = NULL;
+
+  epoch_enter();
+  struct DirectoryTable* table = atomic_load_explicit(&list->table, memory_order_acquire);
+  struct DirectoryNode* node = atomic_load_explicit(&table->buckets[bucket_of(table, event_id)], memory_order_acquire);
+  for (; node; node = atomic_load_explicit(&node->next, memory_order_acquire)) {
+    if (node->event->id == event_id) {
+      event = node->event;
+      break;
     }
-    current = current->next;
   }
+  epoch_exit();
 
-  return NULL;
+  return event;
 }
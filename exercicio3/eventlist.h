@@ -1,7 +1,19 @@
 #ifndef EVENT_LIST_H
 #define EVENT_LIST_H
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include "freerun.h"
+#include "sparse.h"
+
+// Seats taken by one reservation, kept so it can be found without scanning the venue.
+struct Reservation {
+  size_t num_seats;  /// Number of seats, 0 once the reservation is cancelled.
+  size_t* seats;     /// Seat indices (row-major, 0-based) of the reservation.
+};
 
 struct Event {
   unsigned int id;            /// Event id
@@ -10,7 +22,19 @@ struct Event {
   size_t cols;  /// Number of columns.
   size_t rows;  /// Number of rows.
 
-  unsigned int* data;  /// Array of size rows * cols with the reservations for each seat.
+  unsigned char seat_width;  /// Bytes used per seat (1, 2 or 4), widened as reservations grow.
+  void* data;                /// Array of size rows * cols with the reservations for each seat.
+  int data_mapped;           /// Whether data points into a snapshot mapping instead of the heap.
+  struct SeatRow* sparse_rows;  /// Array of size rows with the reserved runs, used instead of data for huge venues.
+
+  struct Reservation* reservation_log;  /// Seats of each reservation, indexed by reservation id - 1.
+  size_t log_capacity;                  /// Number of entries allocated in the reservation log.
+  const uint64_t* snapshot_log;         /// Log still in the snapshot mapping, copied out on first use.
+
+  struct FreeRunTree* free_runs;  /// Free run summaries, built by the first RESERVE_BEST of a dense event.
+
+  int deleted;           /// Set under lock once the event is removed from the list.
+  pthread_mutex_t lock;  /// Serializes reservations and shows of the event.
 };
 
 struct ListNode {
@@ -18,28 +42,59 @@ struct ListNode {
   struct ListNode* next;
 };
 
+// Entry of a bucket of the directory.
+struct DirectoryNode {
+  struct Event* event;
+  _Atomic(struct DirectoryNode*) next;
+};
+
+// Hash table of the events by id. Readers walk it without locks, writers replace whole tables to grow
+// them, and retire the nodes and tables they drop through epoch-based reclamation.
+struct DirectoryTable {
+  size_t mask;  // Number of buckets minus one, a power of two minus one
+  _Atomic(struct DirectoryNode*) buckets[];
+};
+
 // Linked list structure
 struct EventList {
-  struct ListNode* head;  // Head of the list
+  struct ListNode* head;  // Head of the list, in creation order
   struct ListNode* tail;  // Tail of the list
+
+  _Atomic(struct DirectoryTable*) table;  // Directory of the events, for lock-free lookups
+  size_t size;                            // Number of events
+  pthread_rwlock_t lock;                  // Held as writer to add or remove events, as reader to walk the list
 };
 
 /// Creates a new event list.
 /// @return Newly created event list, NULL on failure
 struct EventList* create_list();
 
-/// Appends a new node to the list.
+/// Adds an event to the list and its directory, unless an event with the same id is already there. The
+/// check and the insertion are atomic.
 /// @param list Event list to be modified.
 /// @param data Event to be stored in the new node.
-/// @return 0 if the node was appended successfully, 1 otherwise.
+/// @return 0 if the node was appended successfully, 1 otherwise (including when an
+/// event with the same id is already in the list).
 int append_to_list(struct EventList* list, struct Event* data);
 
+/// Removes an event from the list and its directory. Readers that found it before may go on using it:
+/// the caller retires it with epoch_retire.
+/// @param list Event list to be modified.
+/// @param event_id Event id.
+/// @return The event removed, NULL if there is no event with that id.
+struct Event* remove_from_list(struct EventList* list, unsigned int event_id);
+
+/// Frees an event and everything it owns.
+/// @param event Event to be freed, no longer in any list.
+void free_event(struct Event* event);
+
 /// Removes a node from the list.
 /// @param list Event list to be modified.
 /// @return 0 if the node was removed successfully, 1 otherwise.
 void free_list(struct EventList* list);
 
-/// Retrieves an event in the list.
+/// Retrieves an event in the list through its directory, without taking any lock.
+/// @note The event stays valid while the caller is in the epoch critical section it was looked up in.
 /// @param list Event list to be searched
 /// @param event_id Event id.
 /// @return Pointer to the event if found, NULL otherwise.
@@ -0,0 +1,228 @@
+#include "freerun.h"
+
+#include <stdlib.h>
+
+#include "mem.h"
+
+#define WORD_SEATS 64
+
+static size_t round_up_pow2(size_t n) {
+  size_t size = 1;
+  while (size < n) {
+    size *= 2;
+  }
+  return size;
+}
+
+static uint64_t* row_bits(const struct FreeRunTree* tree, size_t row) {
+  return &tree->free_bits[row * tree->row_words];
+}
+
+static struct FreeRunNode* row_tree(const struct FreeRunTree* tree, size_t row) {
+  return &tree->nodes[row * 2 * tree->row_size];
+}
+
+/// Summarizes the free seats of a word, bit i being the seat i of the word.
+static struct FreeRunNode summarize_word(uint64_t word) {
+  struct FreeRunNode node;
+  node.prefix = ~word == 0 ? WORD_SEATS : (uint32_t)__builtin_ctzll(~word);
+  node.suffix = ~word == 0 ? WORD_SEATS : (uint32_t)__builtin_clzll(~word);
+  node.free = (uint32_t)__builtin_popcountll(word);
+
+  // Each step shortens every run by a seat, so the longest run is gone after as many steps as it has seats.
+  node.best = 0;
+  for (uint64_t runs = word; runs != 0; runs &= runs >> 1) {
+    node.best++;
+  }
+  return node;
+}
+
+/// Combines the summaries of two adjacent ranges of len seats each.
+static struct FreeRunNode combine(struct FreeRunNode left, struct FreeRunNode right, uint32_t len) {
+  struct FreeRunNode node;
+  node.prefix = left.prefix == len ? len + right.prefix : left.prefix;
+  node.suffix = right.suffix == len ? len + left.suffix : right.suffix;
+  node.best = left.suffix + right.prefix;
+  if (left.best > node.best) node.best = left.best;
+  if (right.best > node.best) node.best = right.best;
+  node.free = left.free + right.free;
+  return node;
+}
+
+static struct FreeRowNode combine_rows(struct FreeRowNode left, struct FreeRowNode right) {
+  return (struct FreeRowNode){left.best > right.best ? left.best : right.best, left.free + right.free};
+}
+
+/// Updates the summary of a row in the row-level tree and the nodes above it.
+static void update_top(struct FreeRunTree* tree, size_t row) {
+  struct FreeRunNode root = row_tree(tree, row)[1];
+  size_t i = tree->top_size + row;
+  tree->top[i] = (struct FreeRowNode){root.best, root.free};
+
+  for (i /= 2; i >= 1; i /= 2) {
+    tree->top[i] = combine_rows(tree->top[2 * i], tree->top[2 * i + 1]);
+  }
+}
+
+struct FreeRunTree* freerun_create(size_t rows, size_t cols) {
+  struct FreeRunTree* tree = mem_malloc(MEM_SEATS, sizeof(struct FreeRunTree));
+  if (!tree) return NULL;
+
+  tree->rows = rows;
+  tree->cols = cols;
+  tree->row_words = (cols + WORD_SEATS - 1) / WORD_SEATS;
+  tree->row_size = round_up_pow2(tree->row_words);
+  tree->top_size = round_up_pow2(rows);
+  tree->free_bits = mem_calloc(MEM_SEATS, rows * tree->row_words, sizeof(uint64_t));
+  tree->nodes = mem_calloc(MEM_SEATS, rows * 2 * tree->row_size, sizeof(struct FreeRunNode));
+  tree->top = mem_calloc(MEM_SEATS, 2 * tree->top_size, sizeof(struct FreeRowNode));
+  if (!tree->free_bits || !tree->nodes || !tree->top) {
+    freerun_free(tree);
+    return NULL;
+  }
+
+  // The bits past the last column stay clear, as if those seats were taken.
+  for (size_t row = 0; row < rows; row++) {
+    uint64_t* bits = row_bits(tree, row);
+    for (size_t col = 0; col + WORD_SEATS <= cols; col += WORD_SEATS) {
+      bits[col / WORD_SEATS] = UINT64_MAX;
+    }
+    if (cols % WORD_SEATS != 0) {
+      bits[cols / WORD_SEATS] = ((uint64_t)1 << (cols % WORD_SEATS)) - 1;
+    }
+  }
+
+  freerun_rebuild(tree);
+  return tree;
+}
+
+void freerun_mark_taken(struct FreeRunTree* tree, size_t row, size_t col) {
+  row_bits(tree, row)[col / WORD_SEATS] &= ~((uint64_t)1 << (col % WORD_SEATS));
+}
+
+void freerun_rebuild(struct FreeRunTree* tree) {
+  for (size_t row = 0; row < tree->rows; row++) {
+    const uint64_t* bits = row_bits(tree, row);
+    struct FreeRunNode* nodes = row_tree(tree, row);
+    for (size_t w = 0; w < tree->row_words; w++) {
+      nodes[tree->row_size + w] = summarize_word(bits[w]);
+    }
+
+    uint32_t len = WORD_SEATS;
+    for (size_t level = tree->row_size / 2; level >= 1; level /= 2) {
+      for (size_t i = level; i < 2 * level; i++) {
+        nodes[i] = combine(nodes[2 * i], nodes[2 * i + 1], len);
+      }
+      len *= 2;
+    }
+    tree->top[tree->top_size + row] = (struct FreeRowNode){nodes[1].best, nodes[1].free};
+  }
+  for (size_t i = tree->top_size - 1; i >= 1; i--) {
+    tree->top[i] = combine_rows(tree->top[2 * i], tree->top[2 * i + 1]);
+  }
+}
+
+void freerun_set(struct FreeRunTree* tree, size_t row, size_t col, int is_free) {
+  uint64_t* word = &row_bits(tree, row)[col / WORD_SEATS];
+  uint64_t bit = (uint64_t)1 << (col % WORD_SEATS);
+  *word = is_free ? *word | bit : *word & ~bit;
+
+  struct FreeRunNode* nodes = row_tree(tree, row);
+  size_t i = tree->row_size + col / WORD_SEATS;
+  nodes[i] = summarize_word(*word);
+
+  uint32_t len = WORD_SEATS;
+  for (i /= 2; i >= 1; i /= 2) {
+    nodes[i] = combine(nodes[2 * i], nodes[2 * i + 1], len);
+    len *= 2;
+  }
+
+  update_top(tree, row);
+}
+
+int freerun_find_run(const struct FreeRunTree* tree, size_t count, size_t* row, size_t* col) {
+  if (count == 0 || tree->rows == 0 || tree->top[1].best < count) return 1;
+
+  // Leftmost row whose longest run is long enough.
+  size_t i = 1;
+  while (i < tree->top_size) {
+    i = tree->top[2 * i].best >= count ? 2 * i : 2 * i + 1;
+  }
+  *row = i - tree->top_size;
+
+  // Leftmost run inside that row: either fully in the left half, across the middle or in the right half.
+  const struct FreeRunNode* nodes = row_tree(tree, *row);
+  size_t start = 0;
+  size_t len = tree->row_size * WORD_SEATS;
+  i = 1;
+  while (i < tree->row_size) {
+    const struct FreeRunNode* left = &nodes[2 * i];
+    const struct FreeRunNode* right = &nodes[2 * i + 1];
+    len /= 2;
+    if (left->best >= count) {
+      i = 2 * i;
+    } else if (left->suffix + right->prefix >= count) {
+      *col = start + len - left->suffix;
+      return 0;
+    } else {
+      start += len;
+      i = 2 * i + 1;
+    }
+  }
+
+  // The run is inside a single word: its first seat is the lowest one followed by count - 1 free seats.
+  uint64_t word = row_bits(tree, *row)[i - tree->row_size];
+  uint64_t starts = word;
+  for (size_t k = 1; k < count; k++) {
+    starts &= word >> k;
+  }
+  *col = start + (size_t)__builtin_ctzll(starts);
+  return 0;
+}
+
+struct SeatSearch {
+  size_t wanted;
+  size_t found;
+  size_t* rows;
+  size_t* cols;
+};
+
+static void collect_row(const struct FreeRunTree* tree, size_t row, struct SeatSearch* search) {
+  const uint64_t* bits = row_bits(tree, row);
+  for (size_t w = 0; w < tree->row_words && search->found < search->wanted; w++) {
+    for (uint64_t word = bits[w]; word != 0 && search->found < search->wanted; word &= word - 1) {
+      search->rows[search->found] = row;
+      search->cols[search->found] = w * WORD_SEATS + (size_t)__builtin_ctzll(word);
+      search->found++;
+    }
+  }
+}
+
+static void collect_rows(const struct FreeRunTree* tree, size_t i, size_t start, size_t len, struct SeatSearch* search) {
+  if (search->found == search->wanted || tree->top[i].free == 0) return;
+
+  if (len == 1) {
+    collect_row(tree, start, search);
+    return;
+  }
+
+  collect_rows(tree, 2 * i, start, len / 2, search);
+  collect_rows(tree, 2 * i + 1, start + len / 2, len / 2, search);
+}
+
+int freerun_find_seats(const struct FreeRunTree* tree, size_t count, size_t* rows, size_t* cols) {
+  if (count == 0 || tree->rows == 0 || tree->top[1].free < count) return 1;
+
+  struct SeatSearch search = {count, 0, rows, cols};
+  collect_rows(tree, 1, 0, tree->top_size, &search);
+  return search.found < count;
+}
+
+void freerun_free(struct FreeRunTree* tree) {
+  if (!tree) return;
+
+  mem_free(tree->free_bits);
+  mem_free(tree->nodes);
+  mem_free(tree->top);
+  mem_free(tree);
+}
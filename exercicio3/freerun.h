@@ -0,0 +1,79 @@
+#ifndef EMS_FREERUN_H
+#define EMS_FREERUN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Segment tree node summarizing the free seats of a column range.
+struct FreeRunNode {
+  uint32_t prefix;  /// Free seats at the start of the range.
+  uint32_t suffix;  /// Free seats at the end of the range.
+  uint32_t best;    /// Longest run of free seats inside the range.
+  uint32_t free;    /// Number of free seats in the range.
+};
+
+// Summary of the free seats of a row range, used to find rows without visiting them.
+struct FreeRowNode {
+  uint32_t best;  /// Longest run of free seats of any row in the range.
+  size_t free;    /// Number of free seats in the range.
+};
+
+// Free seats of a venue, one bit each, with a segment tree of the free runs of every row and a tree over
+// the rows. The leaves of a row tree summarize a word of 64 seats, which keeps the trees small enough to
+// exist for every row and to be updated on every seat write.
+struct FreeRunTree {
+  size_t rows;       /// Number of rows.
+  size_t cols;       /// Number of columns.
+  size_t row_words;  /// Words of free_bits per row.
+  size_t row_size;   /// Leaves per row tree (row_words rounded up to a power of two).
+  size_t top_size;   /// Leaves of the row tree (rows rounded up to a power of two).
+
+  uint64_t* free_bits;        /// Bit col % 64 of word row * row_words + col / 64 is set if the seat is free.
+  struct FreeRunNode* nodes;  /// rows trees of 2 * row_size nodes each, root at index 1.
+  struct FreeRowNode* top;    /// 2 * top_size nodes, root at index 1.
+};
+
+/// Creates a tree for a venue with every seat free.
+/// @param rows Number of rows.
+/// @param cols Number of columns.
+/// @return Newly created tree, NULL on failure.
+struct FreeRunTree* freerun_create(size_t rows, size_t cols);
+
+/// Marks a seat as taken without updating the summaries, see freerun_rebuild.
+/// @param tree Tree to be modified.
+/// @param row Row of the seat (0-based).
+/// @param col Column of the seat (0-based).
+void freerun_mark_taken(struct FreeRunTree* tree, size_t row, size_t col);
+
+/// Recomputes every summary from the leaves.
+/// @param tree Tree to be modified.
+void freerun_rebuild(struct FreeRunTree* tree);
+
+/// Updates a seat and the summaries above it.
+/// @param tree Tree to be modified.
+/// @param row Row of the seat (0-based).
+/// @param col Column of the seat (0-based).
+/// @param is_free Whether the seat is now free.
+void freerun_set(struct FreeRunTree* tree, size_t row, size_t col, int is_free);
+
+/// Finds the first run of free adjacent seats, scanning rows front to back.
+/// @param tree Tree to be searched.
+/// @param count Number of adjacent seats wanted.
+/// @param row Pointer to the variable to store the row (0-based) in.
+/// @param col Pointer to the variable to store the first column (0-based) in.
+/// @return 0 if a run was found, 1 otherwise.
+int freerun_find_run(const struct FreeRunTree* tree, size_t count, size_t* row, size_t* col);
+
+/// Finds the first free seats in row-major order.
+/// @param tree Tree to be searched.
+/// @param count Number of seats wanted.
+/// @param rows Array to store the rows (0-based) in.
+/// @param cols Array to store the columns (0-based) in.
+/// @return 0 if count seats were found, 1 otherwise.
+int freerun_find_seats(const struct FreeRunTree* tree, size_t count, size_t* rows, size_t* cols);
+
+/// Frees the tree.
+/// @param tree Tree to be freed.
+void freerun_free(struct FreeRunTree* tree);
+
+#endif  // EMS_FREERUN_H
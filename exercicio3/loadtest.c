@@ -0,0 +1,105 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client.h"
+#include "protocol.h"
+
+#define DEFAULT_REQUESTS 2000
+#define DEFAULT_MAX_DEPTH 64
+
+static double elapsed_seconds(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/// Sends SHOW requests keeping up to depth of them outstanding.
+/// @param session Session to send the requests through.
+/// @param first_event_id Id of the first event to be shown. Outstanding requests show distinct events.
+/// @param num_requests Number of requests to send.
+/// @param depth Maximum number of outstanding requests.
+/// @return Requests answered per second, negative if the connection was lost.
+static double run(struct Session* session, unsigned int first_event_id, unsigned int num_requests, unsigned int depth) {
+  unsigned int sent = 0, answered = 0;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (answered < num_requests) {
+    // Fill the pipeline, then wait for any response to make room.
+    while (sent < num_requests && sent - answered < depth) {
+      uint32_t sequence;
+      uint32_t fields[1] = {first_event_id + sent % depth};
+      if (client_send(session, REQUEST_SHOW, fields, 1, &sequence) != 0) return -1;
+      sent++;
+    }
+
+    uint32_t sequence;
+    int status;
+    if (client_receive(session, &sequence, &status, NULL) != 0) return -1;
+    answered++;
+  }
+
+  return num_requests / elapsed_seconds(&start);
+}
+
+static unsigned int parse_uint(const char* text, const char* name) {
+  char* endptr;
+  unsigned long value = strtoul(text, &endptr, 10);
+  if (*endptr != '\0' || value == 0 || value > UINT_MAX) {
+    fprintf(stderr, "Invalid %s\n", name);
+    exit(1);
+  }
+  return (unsigned int)value;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2 || argc > 4) {
+    fprintf(stderr, "Usage: %s <registration_pipe> [num_requests] [max_depth]\n", argv[0]);
+    return 1;
+  }
+
+  unsigned int num_requests = argc > 2 ? parse_uint(argv[2], "number of requests") : DEFAULT_REQUESTS;
+  unsigned int max_depth = argc > 3 ? parse_uint(argv[3], "maximum depth") : DEFAULT_MAX_DEPTH;
+
+  struct Session session;
+  if (client_connect(argv[1], &session) != 0) {
+    fprintf(stderr, "Failed to connect to server\n");
+    return 1;
+  }
+
+  // Small events of its own, so that every request costs the same and outstanding requests
+  // never wait for each other's event locks.
+  unsigned int event_id = (unsigned int)getpid() * max_depth;
+  for (unsigned int i = 0; i < max_depth; i++) {
+    uint32_t create[3] = {event_id + i, 2, 2};
+    uint32_t sequence;
+    int status;
+    if (client_send(&session, REQUEST_CREATE, create, 3, &sequence) != 0 ||
+        client_receive(&session, &sequence, &status, NULL) != 0) {
+      client_disconnect(&session);
+      return 1;
+    }
+  }
+
+  printf("%6s %14s %8s\n", "depth", "requests/s", "gain");
+  double baseline = 0;
+  for (unsigned int depth = 1; depth <= max_depth; depth *= 2) {
+    double throughput = run(&session, event_id, num_requests, depth);
+    if (throughput < 0) {
+      client_disconnect(&session);
+      return 1;
+    }
+    if (depth == 1) {
+      baseline = throughput;
+    }
+    printf("%6u %14.0f %7.2fx\n", depth, throughput, throughput / baseline);
+  }
+
+  client_disconnect(&session);
+  return 0;
+}
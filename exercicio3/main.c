@@ -9,25 +9,73 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <sys/wait.h> 
+#include "affinity.h"
+#include "client.h"
 #include "constants.h"
 #include "operations.h"
 #include "parser.h"
+#include "ring.h"
+#include "scheduler.h"
+#include "sequencer.h"
+#include "server.h"
+#include "shard.h"
+#include "sizing.h"
 #include <pthread.h>
 
+// Settings shared by every job file, taken from the command line.
+struct Options {
+    unsigned int state_access_delay_ms;
+    int max_processes;
+    int max_threads;
+    int use_wal;                     // Keep a write-ahead log next to each job file
+    unsigned int flush_interval_ms;  // Group commit interval of the write-ahead log
+    unsigned int show_threads;       // Helper threads rendering slices of large events
+    int pin;                         // Pin each process to a set of cores and its threads to cores of the set
+    int pipeline;                    // Parse on a reader thread and execute on the others
+    const char *server_path;         // Registration pipe of the server to run or to send the jobs to
+    int serve;                       // Run as the server instead of processing a jobs directory
+    unsigned int num_shards;         // Processes the events of each job file are split between, 0 for none
+    int zero_copy;                   // Splice large outputs into the output files instead of writing them
+};
+
+// Command handed over from the reader to the executors in pipeline mode.
+struct PipelineItem {
+    struct ParsedCommand command;
+    struct Ticket ticket;
+};
+
+// Commands parsed ahead by a reader thread for executor threads to run.
+struct Pipeline {
+    struct Ring ready;  // Items holding commands to run, in the order they were read
+    struct Ring free;   // Items the reader can fill
+    struct PipelineItem *items;
+};
+
+// Consecutive RESERVEs of one event, read together and run with a single lookup of the event.
+struct ReserveBatch {
+    unsigned int event_id;
+    size_t num_requests;
+    size_t num_seats[MAX_RESERVE_BATCH];  // Number of seats of each RESERVE
+    size_t total_seats;
+    size_t seat_capacity;  // Number of seats allocated in xs and ys
+    size_t *xs;            // Seats of each RESERVE, one after the other
+    size_t *ys;
+    int results[MAX_RESERVE_BATCH];  // Whether each RESERVE failed
+};
+
+// Value of barrier_encountered once the job file is given up: its threads stop, and no new round starts.
+#define JOB_ABORTED 2
+
 struct ThreadArgs {
     int input_file;
-    int fd;
-    pthread_mutex_t *show_list_mutex;
-    pthread_mutex_t *show_reserve_mutex;
-    pthread_cond_t *show_reserve_cond;
-    pthread_mutex_t *delay_mutex;
+    struct Sequencer *sequencer;
+    struct Scheduler *scheduler;  // Workers the commands run as, suspended by WAIT
     pthread_mutex_t *fd_mutex;
-    unsigned int *reserve_in_progress;
     unsigned int thread_id;
-    int max_threads;   
-    unsigned int *delays;
-    unsigned int *wait_id;
-    unsigned int *barrier_encountered;
+    unsigned int *barrier_encountered;  // 1 once a BARRIER is read, JOB_ABORTED once the job file is given up
+    struct Session *session;  // Connection to the server, or to each shard, NULL to execute the jobs locally
+    struct Shards *shards;    // Shards the events are split between, NULL if they are not
+    struct Pipeline *pipeline;  // Commands handed over by the reader in pipeline mode
 };
 
 char *strremove(char *str, const char *sub) {
@@ -40,187 +88,550 @@ char *strremove(char *str, const char *sub) {
     }
     return str;
 }
+/// Whether a command uses the state, and so must be ordered against the commands around it.
+static int uses_state(enum Command type) {
+    return type == CMD_CREATE || type == CMD_RESERVE || type == CMD_RESERVE_BEST || type == CMD_RESERVE_MULTI ||
+           type == CMD_CANCEL || type == CMD_DELETE || type == CMD_SHOW || type == CMD_QUERY || type == CMD_LIST_EVENTS ||
+           type == CMD_STATS;
+}
+
+/// Gives a command its place in the sequence: after the earlier commands on the same events (and the
+/// earlier CREATEs and DELETEs for either, as they change the list of events), or after every earlier command for LIST
+/// and STATS.
+/// @return 0 if the command got a ticket, 1 otherwise.
+static int take_ticket(struct Sequencer *sequencer, const struct ParsedCommand *command, struct Ticket *ticket) {
+    if (command->type == CMD_LIST_EVENTS || command->type == CMD_STATS) {
+        return sequencer_next(sequencer, NULL, 0, 0, ticket);
+    } else if (command->type == CMD_RESERVE_MULTI) {
+        return sequencer_next(sequencer, command->event_ids, command->num_events, 0, ticket);
+    }
+    int changes_list = command->type == CMD_CREATE || command->type == CMD_DELETE;
+    return sequencer_next(sequencer, &command->event_id, 1, changes_list, ticket);
+}
+
+/// Gives up a job file whose command could not get its place in the sequence, as the commands after it would
+/// run out of order.
+/// @note Must be called with the job file held, so that no thread reads past the command.
+/// @param barrier_encountered Flag stopping the other threads, NULL for the reader of pipeline mode, which stops
+/// on its own.
+static void abort_job(unsigned int *barrier_encountered) {
+    fprintf(stderr, "Failed to order command, aborting the job file\n");
+    if (barrier_encountered) {
+        *barrier_encountered = JOB_ABORTED;
+    }
+}
+
+/// Executes a command that uses the state, locally or on the server, reporting failures.
+/// @param session Connection to the server, NULL to execute the command locally.
+/// @param command Command to be executed.
+/// @param output Buffer to append the output of the command to.
+static void execute_command(struct Session *session, struct ParsedCommand *command, struct Buffer *output) {
+    switch (command->type) {
+      case CMD_CREATE:
+        if (session ? client_create(session, command->event_id, command->num_rows, command->num_cols)
+                    : ems_create(command->event_id, command->num_rows, command->num_cols)) {
+          fprintf(stderr, "Failed to create event\n");
+        }
+        break;
+
+      case CMD_RESERVE:
+        if (session ? client_reserve(session, command->event_id, command->num_seats, command->xs, command->ys)
+                    : ems_reserve(command->event_id, command->num_seats, command->xs, command->ys)) {
+          fprintf(stderr, "Failed to reserve seats\n");
+        }
+        break;
+
+      case CMD_RESERVE_MULTI:
+        if (session ? client_reserve_multi(session, command->num_events, command->event_ids, command->multi_seats,
+                                           command->xs, command->ys)
+                    : ems_reserve_multi(command->num_events, command->event_ids, command->multi_seats, command->xs,
+                                        command->ys)) {
+          fprintf(stderr, "Failed to reserve seats\n");
+        }
+        break;
+
+      case CMD_RESERVE_BEST:
+        if (session ? client_reserve_best(session, command->event_id, command->num_seats, command->contiguous)
+                    : ems_reserve_best(command->event_id, command->num_seats, command->contiguous)) {
+          fprintf(stderr, "Failed to reserve seats\n");
+        }
+        break;
+
+      case CMD_SHOW:
+        if (command->binary ? (session ? client_show_bin(session, command->event_id, output)
+                                       : ems_render_show_bin(command->event_id, output))
+                            : (session ? client_show(session, command->event_id, output)
+                                       : ems_render_show(command->event_id, output))) {
+          fprintf(stderr, "Failed to show event\n");
+        }
+        break;
+
+      case CMD_QUERY:
+        if (session ? client_query(session, command->event_id, command->reservation_id, output)
+                    : ems_render_query(command->event_id, command->reservation_id, output)) {
+          fprintf(stderr, "Failed to query reservation\n");
+        }
+        break;
+
+      case CMD_CANCEL:
+        if (session ? client_cancel(session, command->event_id, command->reservation_id)
+                    : ems_cancel(command->event_id, command->reservation_id)) {
+          fprintf(stderr, "Failed to cancel reservation\n");
+        }
+        break;
+
+      case CMD_DELETE:
+        if (session ? client_delete(session, command->event_id) : ems_delete(command->event_id)) {
+          fprintf(stderr, "Failed to delete event\n");
+        }
+        break;
+
+      case CMD_LIST_EVENTS:
+        if (session ? client_list_events(session, output) : ems_render_list_events(output)) {
+          fprintf(stderr, "Failed to list events\n");
+        }
+        break;
+
+      case CMD_STATS:
+        if (session ? client_mem_stats(session, output) : ems_render_mem_stats(output)) {
+          fprintf(stderr, "Failed to render memory statistics\n");
+        }
+        break;
+
+      case CMD_BARRIER:
+      case CMD_WAIT:
+      case CMD_HELP:
+      case CMD_EMPTY:
+      case CMD_INVALID:
+      case EOC:
+        break;
+    }
+}
+
+/// Executes a command that uses the state on the shards, reporting failures: on the shard owning its
+/// events, or on every shard for LIST and STATS.
+/// @param shards Shards the events are split between.
+/// @param sessions Connections to each shard, indexed by shard.
+/// @param command Command to be executed.
+/// @param output Buffer to append the output of the command to.
+static void execute_sharded(struct Shards *shards, struct Session *sessions, struct ParsedCommand *command,
+                            struct Buffer *output) {
+    if (command->type == CMD_LIST_EVENTS) {
+        if (shards_list_events(shards, sessions, output)) {
+          fprintf(stderr, "Failed to list events\n");
+        }
+    } else if (command->type == CMD_STATS) {
+        if (shards_mem_stats(shards, sessions, output)) {
+          fprintf(stderr, "Failed to render memory statistics\n");
+        }
+    } else if (command->type == CMD_CREATE || command->type == CMD_DELETE) {
+        // The router keeps the order of the events, which no shard sees whole.
+        struct Session *session = &sessions[shard_of(shards, command->event_id)];
+        int created = command->type == CMD_CREATE;
+        if (created ? client_create(session, command->event_id, command->num_rows, command->num_cols)
+                    : client_delete(session, command->event_id)) {
+          fputs(created ? "Failed to create event\n" : "Failed to delete event\n", stderr);
+        } else {
+          shards_record(shards, command->event_id, created);
+        }
+    } else if (command->type == CMD_RESERVE_MULTI) {
+        // A transaction runs on a single shard, as shards do not coordinate.
+        unsigned int shard = shard_of(shards, command->event_ids[0]);
+        for (size_t i = 1; i < command->num_events; ++i) {
+            if (shard_of(shards, command->event_ids[i]) != shard) {
+                fprintf(stderr, "Events of a reservation must be in the same shard\n");
+                fprintf(stderr, "Failed to reserve seats\n");
+                return;
+            }
+        }
+        execute_command(&sessions[shard], command, output);
+    } else {
+        execute_command(&sessions[shard_of(shards, command->event_id)], command, output);
+    }
+}
+
+/// Runs a command read from the job file on behalf of a thread.
+/// @param thread_args Arguments of the thread.
+/// @param command Command to be run.
+/// @param ticket Place of the command in the sequence, if it uses the state.
+/// @param output Buffer for the output of the command, left empty.
+/// @return 1 if the command was a BARRIER, 0 otherwise.
+static int run_command(struct ThreadArgs *thread_args, struct ParsedCommand *command, const struct Ticket *ticket,
+                       struct Buffer *output) {
+    // orders the effects and the output of commands as they appear in the job file
+    struct Sequencer *sequencer = thread_args->sequencer;
+    switch (command->type) {
+      case CMD_CREATE:
+      case CMD_RESERVE:
+      case CMD_RESERVE_MULTI:
+      case CMD_RESERVE_BEST:
+      case CMD_SHOW:
+      case CMD_QUERY:
+      case CMD_CANCEL:
+      case CMD_DELETE:
+      case CMD_LIST_EVENTS:
+      case CMD_STATS:
+        sequencer_wait(sequencer, ticket);
+        if (thread_args->shards) {
+            execute_sharded(thread_args->shards, thread_args->session, command, output);
+        } else {
+            execute_command(thread_args->session, command, output);
+        }
+        sequencer_complete(sequencer, ticket, output);
+        break;
+
+      case CMD_WAIT: 
+        if (command->delay > 0 && command->thread_id != 0) {
+          printf("Waiting for thread...\n");
+          scheduler_delay(thread_args->scheduler, command->thread_id, command->delay);
+        }
+        else{
+          printf("Waiting...\n");
+          scheduler_delay(thread_args->scheduler, 0, command->delay);
+        }
+        break;
+
+      case CMD_INVALID:
+        fprintf(stderr, "Invalid command. See HELP for usage: \n");
+        break;
+
+      case CMD_HELP:
+        printf(
+            "Available commands:\n"
+            "  CREATE <event_id> <num_rows> <num_columns>\n"
+            "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  RESERVE_BEST <event_id> <num_seats> [contiguous]\n"
+            "  RESERVE_MULTI <event_id> [(<x1>,<y1>) ...] <event_id> [(<x1>,<y1>) ...] ...\n"
+            "  SHOW [BIN] <event_id>\n"
+            "  QUERY <event_id> <reservation_id>\n"
+            "  CANCEL <event_id> <reservation_id>\n"
+            "  DELETE <event_id>\n"
+            "  LIST\n"
+            "  STATS MEM\n"
+            "  WAIT <delay_ms> [thread_id]\n"  // thread_id is not implemented
+            "  BARRIER\n"                      // Not implemented
+            "  HELP\n");
+
+        break;
+
+      case CMD_BARRIER:
+        printf("Barrier encountered in Thread %d\n", thread_args->thread_id);
+        *thread_args->barrier_encountered = 1;
+        return 1;
+
+      case CMD_EMPTY:
+        break;
+
+      case EOC:
+        break;
+    }
+    return 0;
+}
+
+/// Adds a RESERVE to a batch, growing its seats as needed.
+/// @return 0 if the RESERVE was added, 1 on allocation failure.
+static int batch_add(struct ReserveBatch *batch, const struct ParsedCommand *command) {
+    if (batch->total_seats + command->num_seats > batch->seat_capacity) {
+        size_t capacity = batch->seat_capacity ? 2 * batch->seat_capacity : MAX_RESERVATION_SIZE;
+        while (capacity < batch->total_seats + command->num_seats) {
+            capacity *= 2;
+        }
+        size_t *xs = realloc(batch->xs, capacity * sizeof(size_t));
+        if (xs == NULL) return 1;
+        batch->xs = xs;
+        size_t *ys = realloc(batch->ys, capacity * sizeof(size_t));
+        if (ys == NULL) return 1;
+        batch->ys = ys;
+        batch->seat_capacity = capacity;
+    }
+    memcpy(batch->xs + batch->total_seats, command->xs, command->num_seats * sizeof(size_t));
+    memcpy(batch->ys + batch->total_seats, command->ys, command->num_seats * sizeof(size_t));
+    batch->num_seats[batch->num_requests++] = command->num_seats;
+    batch->total_seats += command->num_seats;
+    return 0;
+}
+
+/// Runs a batch of RESERVEs in the place of its first one in the sequence, reporting each that failed.
+/// @param thread_args Arguments of the thread.
+/// @param batch Batch to be run.
+/// @param ticket Place of the batch in the sequence.
+/// @param output Buffer for the output of the batch, left empty.
+static void run_batch(struct ThreadArgs *thread_args, struct ReserveBatch *batch, const struct Ticket *ticket,
+                      struct Buffer *output) {
+    sequencer_wait(thread_args->sequencer, ticket);
+    ems_reserve_batch(batch->event_id, batch->num_requests, batch->num_seats, batch->xs, batch->ys, batch->results);
+    for (size_t i = 0; i < batch->num_requests; ++i) {
+        if (batch->results[i]) {
+            fprintf(stderr, "Failed to reserve seats\n");
+        }
+    }
+    sequencer_complete(thread_args->sequencer, ticket, output);
+}
+
 void *thread_function(void *args) {
     struct ThreadArgs *thread_args = (struct ThreadArgs *)args;
     int input_file = thread_args->input_file;
-    int fd = thread_args->fd;
-    unsigned int *wait_id = thread_args->wait_id;
-    pthread_mutex_t *delay_mutex = thread_args->delay_mutex;
-    // avoid show and list at same time
-    pthread_mutex_t *show_list_mutex = thread_args->show_list_mutex;
-    // avoid reserve and show at same time
-    pthread_mutex_t *show_reserve_mutex = thread_args->show_reserve_mutex;
-    // avoid show and reserve at same time
-    pthread_cond_t *show_reserve_cond = thread_args->show_reserve_cond;
-    // avoid fd access at same time
+    // avoid reading the job file at same time
     pthread_mutex_t *fd_mutex = thread_args->fd_mutex;
-    unsigned int *reserve_in_progress = thread_args->reserve_in_progress;
-    unsigned int event_id, delay, delay_temp;
-    size_t num_rows, num_columns, num_coords;
-    int show_result;
-    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    int parse_result;
+    struct ParsedCommand commands[2];
+    struct Ticket tickets[2];
+    struct ParsedCommand *command = &commands[0];
+    struct Ticket *ticket = &tickets[0];
+    struct ParsedCommand *next = &commands[1];  // Command read past a batch, run after it
+    struct Ticket *next_ticket = &tickets[1];
+    int next_result = 0;
+    int read_ahead = 0;  // Whether next holds a command
+    // Only local state is reserved in batches: the server and the shards get every RESERVE on its own.
+    struct ReserveBatch batch = {.seat_capacity = 0, .xs = NULL, .ys = NULL};
+    struct Buffer output;  // Output of the current command, written by the sequencer
+    buffer_init(&output);
+    void *result = NULL;
+    affinity_pin_thread(thread_args->thread_id - 1);
     fflush(stdout);
-    enum Command command_type;
     while (1) {
-      if(*thread_args->barrier_encountered == 1){
-        return NULL;
-      }
-      pthread_mutex_lock(delay_mutex);
-      (delay_temp = *(thread_args->delays + thread_args->thread_id - 1));
-      pthread_mutex_unlock(delay_mutex);
-      if(delay_temp > 0){
-        printf("thread: %d. Waited for %d ms\n",thread_args->thread_id, delay_temp);
-        ems_wait(delay_temp);
-        pthread_mutex_lock(delay_mutex);
-        *(thread_args->delays + thread_args->thread_id - 1) -= delay_temp; 
-        pthread_mutex_unlock(delay_mutex);
+      // A command read past a batch comes before the BARRIER, so it still runs.
+      if(*thread_args->barrier_encountered != 0 && !read_ahead){
+        break;
       }
+      // Runs the next command as whichever worker is not suspended by a WAIT
+      unsigned int worker = scheduler_acquire(thread_args->scheduler);
       pthread_mutex_lock(fd_mutex);
-      command_type = get_next(input_file);
-      pthread_mutex_unlock(fd_mutex);
-      if(command_type == EOC){
+      int held = read_ahead;
+      // Another thread read a BARRIER, or gave up the job file, while this one waited for the file.
+      if (!held && *thread_args->barrier_encountered != 0) {
+        pthread_mutex_unlock(fd_mutex);
+        scheduler_release(thread_args->scheduler, worker);
         break;
       }
-      switch (command_type) {
-        case CMD_CREATE:
-          pthread_mutex_lock(fd_mutex);
-          if (parse_create(input_file, &event_id, &num_rows, &num_columns) != 0) {
-            fprintf(stderr, "Invalid command. See HELP for usage\n");
-            pthread_mutex_unlock(fd_mutex);
+      if (held) {
+        struct ParsedCommand *swap_command = command;
+        struct Ticket *swap_ticket = ticket;
+        command = next;
+        ticket = next_ticket;
+        next = swap_command;
+        next_ticket = swap_ticket;
+        parse_result = next_result;
+        read_ahead = 0;
+      } else {
+        parse_result = parse_command(input_file, command);
+        // Commands get their place in the sequence in the order they are read. BARRIER needs none: every
+        // thread stops before it, so it already runs after every earlier command.
+        if (parse_result == 0 && uses_state(command->type) &&
+            take_ticket(thread_args->sequencer, command, ticket) != 0) {
+          abort_job(thread_args->barrier_encountered);
+          parse_result = -1;
+        }
+        // Published while the file is held, so that no thread reads past the BARRIER.
+        if (parse_result == 0 && command->type == CMD_BARRIER) {
+          *thread_args->barrier_encountered = 1;
+        }
+      }
+      // Consecutive RESERVEs of one event run as a batch, which looks the event up once. The command read
+      // past them takes its place in the sequence now, and runs next. A held RESERVE runs on its own, as
+      // other threads may have read the commands that follow it.
+      int batched = 0;
+      if (parse_result == 0 && !held && thread_args->session == NULL && command->type == CMD_RESERVE) {
+        batch.event_id = command->event_id;
+        batch.num_requests = 0;
+        batch.total_seats = 0;
+        int added = batch_add(&batch, command) == 0;
+        while (added && batch.num_requests < MAX_RESERVE_BATCH) {
+          next_result = parse_command(input_file, next);
+          if (next_result == 0 && next->type == CMD_RESERVE && next->event_id == batch.event_id &&
+              batch_add(&batch, next) == 0) {
             continue;
           }
-          pthread_mutex_unlock(fd_mutex);
-          if (ems_create(event_id, num_rows, num_columns)) {
-            fprintf(stderr, "Failed to create event\n");
+          if (next_result == 0 && uses_state(next->type) &&
+              take_ticket(thread_args->sequencer, next, next_ticket) != 0) {
+            abort_job(thread_args->barrier_encountered);
+            next_result = -1;
           }
-          break;
-
-        case CMD_RESERVE:
-          pthread_mutex_lock(show_reserve_mutex);
-          // Set RESERVE in progress
-          *reserve_in_progress = 1;
-          pthread_mutex_unlock(show_reserve_mutex);
-          pthread_mutex_lock(fd_mutex);
-          num_coords = parse_reserve(input_file, MAX_RESERVATION_SIZE, &event_id, xs, ys);
-          pthread_mutex_unlock(fd_mutex);
-          if (num_coords == 0) {
-            fprintf(stderr, "Invalid command. See HELP for usage\n");
-            pthread_mutex_lock(show_reserve_mutex);
-            *reserve_in_progress = 0;
-            pthread_cond_signal(show_reserve_cond);
-            pthread_mutex_unlock(show_reserve_mutex);
-            continue;
+          // The batch runs before the BARRIER, but the other threads stop at it now.
+          if (next_result == 0 && next->type == CMD_BARRIER) {
+            *thread_args->barrier_encountered = 1;
           }
-
-          if (ems_reserve(event_id, num_coords, xs, ys)) {
-            fprintf(stderr, "Failed to reserve seats\n");
-          }
-          pthread_mutex_lock(show_reserve_mutex);
-          *reserve_in_progress = 0;
-          pthread_cond_signal(show_reserve_cond);
-          pthread_mutex_unlock(show_reserve_mutex);
+          read_ahead = 1;
           break;
+        }
+        batched = batch.num_requests > 1;
+      }
+      pthread_mutex_unlock(fd_mutex);
+      if(command->type == EOC){
+        scheduler_release(thread_args->scheduler, worker);
+        break;
+      }
+      // A command without a place in the sequence was already reported when the job file was given up.
+      if (parse_result != 0) {
+        if (parse_result > 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+        }
+        scheduler_release(thread_args->scheduler, worker);
+        continue;
+      }
+      int barrier = 0;
+      if (batched) {
+        run_batch(thread_args, &batch, ticket, &output);
+      } else {
+        barrier = run_command(thread_args, command, ticket, &output);
+      }
+      scheduler_release(thread_args->scheduler, worker);
+      if (barrier) {
+        result = thread_args->barrier_encountered;
+        break;
+      }
+    }
+    free(batch.xs);
+    free(batch.ys);
+    buffer_free(&output);
+    return result;
+}
 
-        case CMD_SHOW:
-          pthread_mutex_lock(show_list_mutex);
-          pthread_mutex_lock(show_reserve_mutex);
-          while (*reserve_in_progress) {
-              pthread_cond_wait(show_reserve_cond, show_reserve_mutex);
-          }
-          pthread_mutex_unlock(show_reserve_mutex);
-          pthread_mutex_lock(fd_mutex);
-          show_result = parse_show(input_file, &event_id);
-          pthread_mutex_unlock(fd_mutex);
-          if (show_result != 0) {
-            pthread_mutex_lock(show_reserve_mutex);
-            *reserve_in_progress = 0;
-            pthread_cond_signal(show_reserve_cond);
-            pthread_mutex_unlock(show_reserve_mutex);
-            pthread_mutex_unlock(show_list_mutex); 
-            fprintf(stderr, "Invalid command. See HELP for usage\n");
-            continue;
-          }
+/// Executor of pipeline mode: runs the commands handed over by the reader until it hands over EOC.
+void *executor_function(void *args) {
+    struct ThreadArgs *thread_args = (struct ThreadArgs *)args;
+    struct Pipeline *pipeline = thread_args->pipeline;
+    struct Buffer output;  // Output of the current command, written by the sequencer
+    buffer_init(&output);
+    affinity_pin_thread(thread_args->thread_id - 1);
+    while (1) {
+      unsigned int worker = scheduler_acquire(thread_args->scheduler);
+      struct PipelineItem *item = ring_pop(&pipeline->ready);
+      int end = item->command.type == EOC;
+      if (!end) {
+        run_command(thread_args, &item->command, &item->ticket, &output);
+      }
+      scheduler_release(thread_args->scheduler, worker);
+      ring_push(&pipeline->free, item);
+      if (end) {
+        break;
+      }
+    }
+    buffer_free(&output);
+    return NULL;
+}
 
-          if (ems_show(event_id, fd)) {
-            fprintf(stderr, "Failed to show event\n");
-          }
-          pthread_mutex_lock(show_reserve_mutex);
-          *reserve_in_progress = 0;
-          pthread_cond_signal(show_reserve_cond);
-          pthread_mutex_unlock(show_reserve_mutex);
-          pthread_mutex_unlock(show_list_mutex); 
-          break;
+/// Reader of pipeline mode: parses commands ahead of the executors until the end of the job file, a BARRIER
+/// or a command it cannot give a place in the sequence, then hands every executor an EOC.
+/// @return 1 if a BARRIER was read, 0 otherwise.
+static int read_commands(int input_file, struct Sequencer *sequencer, struct Pipeline *pipeline, int num_executors) {
+    int barrier = 0;
+    while (1) {
+      struct PipelineItem *item = ring_pop(&pipeline->free);
+      int parse_result = parse_command(input_file, &item->command);
+      if (parse_result == 0 && uses_state(item->command.type) &&
+          take_ticket(sequencer, &item->command, &item->ticket) != 0) {
+        abort_job(NULL);
+        ring_push(&pipeline->free, item);
+        break;
+      }
+      if (item->command.type == EOC || (parse_result == 0 && item->command.type == CMD_BARRIER)) {
+        barrier = item->command.type == CMD_BARRIER;
+        ring_push(&pipeline->free, item);
+        break;
+      }
+      if (parse_result != 0) {
+        fprintf(stderr, "Invalid command. See HELP for usage\n");
+        ring_push(&pipeline->free, item);
+        continue;
+      }
+      ring_push(&pipeline->ready, item);
+    }
 
-        case CMD_LIST_EVENTS:
-          pthread_mutex_lock(show_list_mutex);
-          pthread_mutex_lock(fd_mutex);
-          if (ems_list_events(fd)) {
-            fprintf(stderr, "Failed to list events\n");
-          }
-          pthread_mutex_unlock(fd_mutex);
-          pthread_mutex_unlock(show_list_mutex); 
-          break;
-        case CMD_WAIT: 
-        pthread_mutex_lock(fd_mutex);
-          if (parse_wait(input_file, &delay, wait_id) == -1) {
-              fprintf(stderr, "Invalid command. See HELP for usage\n");
-              pthread_mutex_unlock(fd_mutex);
-              continue;
-          }
-          pthread_mutex_unlock(fd_mutex);
-          if (delay > 0 && *wait_id != 0) {
-            printf("Waiting for thread...\n");
-            pthread_mutex_lock(delay_mutex);
-            *(thread_args->delays + *wait_id - 1) += delay;
-            pthread_mutex_unlock(delay_mutex);
-          }
-          else{
-            printf("Waiting...\n");
-            pthread_mutex_lock(delay_mutex);
-            for (int i = 0; i < thread_args->max_threads; ++i) {
-              *(thread_args->delays + i) += delay;
-            }
-            pthread_mutex_unlock(delay_mutex);
-          }
-          
-          delay = 0;
-          
-          break;
+    for (int i = 0; i < num_executors; ++i) {
+      struct PipelineItem *item = ring_pop(&pipeline->free);
+      item->command.type = EOC;
+      ring_push(&pipeline->ready, item);
+    }
+    return barrier;
+}
 
-        case CMD_INVALID:
-          fprintf(stderr, "Invalid command. See HELP for usage: \n");
-          break;
+/// Processes a job file in pipeline mode, with the calling thread as the reader.
+/// @return 0 if the job file was processed, 1 if the pipeline could not be set up.
+static int run_pipeline(int input_file, struct Sequencer *sequencer, struct ThreadArgs *thread_args_array,
+                        int max_threads) {
+    struct Pipeline pipeline;
+    pipeline.items = malloc(PIPELINE_DEPTH * sizeof(struct PipelineItem));
+    if (!pipeline.items) {
+        fprintf(stderr, "Error allocating memory for pipeline\n");
+        return 1;
+    }
+    if (ring_init(&pipeline.ready, PIPELINE_DEPTH) != 0) {
+        free(pipeline.items);
+        return 1;
+    }
+    if (ring_init(&pipeline.free, PIPELINE_DEPTH) != 0) {
+        ring_destroy(&pipeline.ready);
+        free(pipeline.items);
+        return 1;
+    }
+    for (size_t i = 0; i < PIPELINE_DEPTH; ++i) {
+        ring_push(&pipeline.free, &pipeline.items[i]);
+    }
 
-        case CMD_HELP:
-          printf(
-              "Available commands:\n"
-              "  CREATE <event_id> <num_rows> <num_columns>\n"
-              "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
-              "  SHOW <event_id>\n"
-              "  LIST\n"
-              "  WAIT <delay_ms> [thread_id]\n"  // thread_id is not implemented
-              "  BARRIER\n"                      // Not implemented
-              "  HELP\n");
+    pthread_t threads[max_threads];
+    int barrier = 1;
+    while (barrier) {
+        int started = 0;
+        for (int i = 0; i < max_threads; ++i) {
+            thread_args_array[i].pipeline = &pipeline;
+            if (pthread_create(&threads[i], NULL, executor_function, (void *)&thread_args_array[i]) != 0) {
+                perror("Error creating thread");
+                break;
+            }
+            started++;
+        }
+        barrier = started > 0 && read_commands(input_file, sequencer, &pipeline, started);
+        for (int i = 0; i < started; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        if (barrier) {
+            printf("Barrier encountered by the reader\n");
+            printf("Starting new round of parallel processing\n");
+        }
+    }
 
-          break;
+    // The reader stalls on a full pipeline, executors on an empty one.
+    printf("Pipeline: depth %d, max depth %zu, reader stalls %lu, executor stalls %lu\n", PIPELINE_DEPTH,
+           atomic_load(&pipeline.ready.max_depth), atomic_load(&pipeline.free.pop_stalls),
+           atomic_load(&pipeline.ready.pop_stalls));
+    ring_destroy(&pipeline.ready);
+    ring_destroy(&pipeline.free);
+    free(pipeline.items);
+    return 0;
+}
 
-        case CMD_BARRIER:
-          printf("Barrier encountered in Thread %d\n", thread_args->thread_id);
-          *thread_args->barrier_encountered = 1;
-          return thread_args->barrier_encountered;
-          break;
-        case CMD_EMPTY:
-          break;
+/// Serves one shard of a job file: a state of its own, for the events whose ids map to the shard.
+/// @param registration_path Registration pipe the threads of the job file connect through.
+/// @param arg Options of the program.
+/// @return Exit status of the shard process.
+static int run_shard(const char *registration_path, void *arg) {
+  const struct Options *options = arg;
+  if (ems_init(options->state_access_delay_ms, NULL, options->flush_interval_ms, options->show_threads)) {
+      fprintf(stderr, "Failed to initialize EMS\n");
+      return 1;
+  }
+  int result = server_run(registration_path, options->max_threads);
+  ems_terminate();
+  return result;
+}
 
-        case EOC:
-          ems_terminate();
-          return NULL;
-      }
-    }
-    return NULL;
+/// Closes the sessions of a job file, then stops its shards if it has any.
+/// @param sessions Sessions to be closed, freed afterwards.
+/// @param num_sessions Number of sessions.
+/// @param shards Shards to be stopped, NULL if the events are not sharded.
+static void disconnect_sessions(struct Session *sessions, int num_sessions, struct Shards *shards) {
+  for (int i = 0; i < num_sessions; ++i) {
+      client_disconnect(&sessions[i]);
+  }
+  free(sessions);
+  if (shards) {
+      shards_stop(shards);
+  }
 }
 
-void process_job_file(const char *jobs_directory, const char *filename, int max_threads) {
+void process_job_file(const char *jobs_directory, const char *filename, const struct Options *options) {
+  int max_threads = options->max_threads;
   char file_path[4096];
   snprintf(file_path, 4096, "%s/%s", jobs_directory, filename);
   int input_file = open(file_path, O_RDONLY);
@@ -243,50 +654,94 @@ void process_job_file(const char *jobs_directory, const char *filename, int max_
       close(input_file);
       return;
   }
-  pthread_mutex_t show_list_mutex = PTHREAD_MUTEX_INITIALIZER;
-  pthread_mutex_t show_reserve_mutex = PTHREAD_MUTEX_INITIALIZER;
+  // Each job file has its own state, recovered from its log when there is one, unless a server keeps it.
+  char wal_path[8192];
+  snprintf(wal_path, sizeof(wal_path), "%s.wal", file_path);
+  strremove(wal_path, ".jobs");
+  // With shards, every thread has a session with each shard instead of one with the server.
+  struct Shards shards;
+  struct Shards *sharded = options->num_shards ? &shards : NULL;
+  int sessions_per_thread = sharded ? (int)options->num_shards : 1;
+  int num_sessions = max_threads * sessions_per_thread;
+  struct Session *sessions = NULL;
+  if (sharded && shards_start(sharded, options->num_shards, run_shard, (void *)options) != 0) {
+      fprintf(stderr, "Failed to start shards\n");
+      close(input_file);
+      close(fd);
+      return;
+  }
+  if (options->server_path || sharded) {
+      sessions = malloc((size_t)num_sessions * sizeof(struct Session));
+      int connected = 0;
+      while (sessions && connected < num_sessions &&
+             client_connect(sharded ? sharded->paths[connected % sessions_per_thread] : options->server_path,
+                            &sessions[connected]) == 0) {
+          connected++;
+      }
+      if (connected < num_sessions) {
+          fprintf(stderr, "Failed to connect to server\n");
+          disconnect_sessions(sessions, connected, sharded);
+          close(input_file);
+          close(fd);
+          return;
+      }
+  } else if (ems_init(options->state_access_delay_ms, options->use_wal ? wal_path : NULL, options->flush_interval_ms,
+                      options->show_threads)) {
+      fprintf(stderr, "Failed to initialize EMS\n");
+      close(input_file);
+      close(fd);
+      return;
+  }
   pthread_mutex_t fd_mutex = PTHREAD_MUTEX_INITIALIZER;
-  pthread_mutex_t delay_mutex = PTHREAD_MUTEX_INITIALIZER;
-  unsigned int *reserve_in_progress = malloc(sizeof(unsigned int));
-  *reserve_in_progress = 0;
-  pthread_cond_t show_reserve_cond = PTHREAD_COND_INITIALIZER;
-  unsigned int *delays_shared = malloc(sizeof(unsigned int) * (unsigned int)max_threads);
-  for (int i = 0; i < max_threads; ++i) {
-      *(delays_shared + i) = 0;
+  struct Sequencer sequencer;
+  struct Scheduler scheduler;
+  int sequencer_failed = sequencer_init(&sequencer, fd, options->zero_copy) != 0;
+  if (sequencer_failed || scheduler_init(&scheduler, (unsigned int)max_threads) != 0) {
+      if (!sequencer_failed) {
+          sequencer_destroy(&sequencer);
+      }
+      if (sessions) {
+          disconnect_sessions(sessions, num_sessions, sharded);
+      } else {
+          ems_terminate();
+      }
+      close(input_file);
+      close(fd);
+      return;
   }
-  unsigned int *wait_id_shared = malloc(sizeof(unsigned int));
   unsigned int *barrier_encountered = malloc(sizeof(unsigned int));
   *barrier_encountered = 0;
-  *wait_id_shared = 0;
   // Create an array to store thread IDs
   pthread_t threads[max_threads];
   struct ThreadArgs *thread_args_array = malloc((size_t)max_threads * sizeof(struct ThreadArgs));
   // Create threads
   for (int i = 0; i < max_threads; ++i) {
       thread_args_array[i].input_file = input_file;
-      thread_args_array[i].fd = fd;
-      thread_args_array[i].show_list_mutex = &show_list_mutex;
-      thread_args_array[i].delay_mutex = &delay_mutex;
-      thread_args_array[i].show_reserve_mutex = &show_reserve_mutex;
+      thread_args_array[i].sequencer = &sequencer;
+      thread_args_array[i].scheduler = &scheduler;
       thread_args_array[i].fd_mutex = &fd_mutex;
-      thread_args_array[i].show_reserve_cond = &show_reserve_cond;
-      thread_args_array[i].reserve_in_progress = reserve_in_progress;
       thread_args_array[i].thread_id =(unsigned int) (i + 1);
-      thread_args_array[i].delays = delays_shared;
-      thread_args_array[i].max_threads = max_threads;
-      thread_args_array[i].wait_id = wait_id_shared;
       thread_args_array[i].barrier_encountered = barrier_encountered;
-        if (pthread_create(&threads[i], NULL, thread_function, (void *)&thread_args_array[i]) != 0) {
-            perror("Error creating thread");
-            break;
-        }
-    }
-    
-  // Wait for all threads to finish
-  for (int i = 0; i < max_threads; ++i) {
-      pthread_join(threads[i], NULL);
+      thread_args_array[i].session = sessions ? &sessions[i * sessions_per_thread] : NULL;
+      thread_args_array[i].shards = sharded;
+      thread_args_array[i].pipeline = NULL;
+  }
+  unsigned int status = 0;
+  if (options->pipeline) {
+      run_pipeline(input_file, &sequencer, thread_args_array, max_threads);
+  } else {
+      for (int i = 0; i < max_threads; ++i) {
+          if (pthread_create(&threads[i], NULL, thread_function, (void *)&thread_args_array[i]) != 0) {
+              perror("Error creating thread");
+              break;
+          }
+      }
+      // Wait for all threads to finish
+      for (int i = 0; i < max_threads; ++i) {
+          pthread_join(threads[i], NULL);
+      }
+      status = *barrier_encountered;
   }
-  unsigned int status = *barrier_encountered;
   while (status == 1) {
       // starts a new round of threads
       printf("Starting new round of parallel processing\n");
@@ -305,54 +760,186 @@ void process_job_file(const char *jobs_directory, const char *filename, int max_
     }
 
   // Close and free everything
+  if (sessions) {
+      disconnect_sessions(sessions, num_sessions, sharded);
+  } else {
+      ems_terminate();
+  }
+  if (options->zero_copy) {
+      output_report(&sequencer.output);
+  }
+  scheduler_destroy(&scheduler);
+  sequencer_destroy(&sequencer);
   close(fd);
-  pthread_mutex_destroy(&show_list_mutex);
-  pthread_cond_destroy(&show_reserve_cond);
-  pthread_mutex_destroy(&show_reserve_mutex);
   pthread_mutex_destroy(&fd_mutex);
   free(barrier_encountered);
-  free(delays_shared);
-  free(wait_id_shared);
-  free(reserve_in_progress);
   free(thread_args_array);
 }
 
 
+static void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [-a] [-p] [-w] [-z] [-i flush_interval_ms] [-r show_threads] [-c registration_pipe | -n shards] "
+          "<jobs_directory> <max_processes> <max_threads> [delay]\n"
+          "       %s -s registration_pipe [-w] [-i flush_interval_ms] [-r show_threads] <max_threads> [delay]\n"
+          "       max_processes and max_threads may be \"auto\" to size them from the CPUs and the workload\n"
+          "       -n splits the events of each job file between that many processes, by id\n"
+          "       -z splices large outputs into the output files, reporting the bytes spliced and written\n",
+          program, program);
+}
+
+/// Keeps the state resident and serves clients until interrupted.
+/// @return Exit status of the program.
+static int run_server(const struct Options *options) {
+  // The log of a server sits next to its registration pipe.
+  char wal_path[8192];
+  snprintf(wal_path, sizeof(wal_path), "%s.wal", options->server_path);
+  if (ems_init(options->state_access_delay_ms, options->use_wal ? wal_path : NULL, options->flush_interval_ms,
+                      options->show_threads)) {
+      fprintf(stderr, "Failed to initialize EMS\n");
+      return 1;
+  }
+
+  int result = server_run(options->server_path, options->max_threads);
+  ems_terminate();
+  return result;
+}
+
 int main(int argc, char *argv[]) {
-  unsigned int state_access_delay_ms = STATE_ACCESS_DELAY_MS;
+  struct Options options = {STATE_ACCESS_DELAY_MS, 0, 0, 0, WAL_FLUSH_INTERVAL_MS, 0, 0, 0, NULL, 0, 0, 0};
+  const char *program = argv[0];
   const char *jobs_directory;
-  jobs_directory = argv[1];
-  if (argc >= 4) {
+  int opt;
+  while ((opt = getopt(argc, argv, "apwzi:r:s:c:n:")) != -1) {
+      switch (opt) {
+        case 's':
+          options.serve = 1;
+          options.server_path = optarg;
+          break;
+        case 'c':
+          options.serve = 0;
+          options.server_path = optarg;
+          break;
+        case 'a':
+          options.pin = 1;
+          break;
+        case 'p':
+          options.pipeline = 1;
+          break;
+        case 'w':
+          options.use_wal = 1;
+          break;
+        case 'z':
+          options.zero_copy = 1;
+          break;
+        case 'i': {
+          char *endptr;
+          unsigned long int interval = strtoul(optarg, &endptr, 10);
+          if (*endptr != '\0' || interval > UINT_MAX) {
+              fprintf(stderr, "Invalid flush interval\n");
+              return 1;
+          }
+          options.flush_interval_ms = (unsigned int)interval;
+          break;
+        }
+        case 'r': {
+          char *endptr;
+          unsigned long int threads = strtoul(optarg, &endptr, 10);
+          if (*endptr != '\0' || threads > UINT_MAX) {
+              fprintf(stderr, "Invalid number of show threads\n");
+              return 1;
+          }
+          options.show_threads = (unsigned int)threads;
+          break;
+        }
+        case 'n': {
+          char *endptr;
+          unsigned long int shards = strtoul(optarg, &endptr, 10);
+          if (*optarg == '\0' || *endptr != '\0' || shards == 0 || shards > MAX_SHARDS) {
+              fprintf(stderr, "Invalid number of shards\n");
+              return 1;
+          }
+          options.num_shards = (unsigned int)shards;
+          break;
+        }
+        default:
+          usage(program);
+          return 1;
+      }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+  // Shards keep their state in memory only, and are servers of their own.
+  if (options.num_shards && (options.server_path || options.use_wal)) {
+      fprintf(stderr, "Shards cannot be combined with -s, -c or -w\n");
+      return 1;
+  }
+
+  if (options.serve) {
+      if (argc != 2 && argc != 3) {
+          usage(program);
+          return 1;
+      }
+      if (argc == 3) {
+          char *endptr;
+          unsigned long int delay = strtoul(argv[2], &endptr, 10);
+          if (*endptr != '\0' || delay > UINT_MAX) {
+              fprintf(stderr, "Invalid delay value or value too large\n");
+              return 1;
+          }
+          options.state_access_delay_ms = (unsigned int)delay;
+      }
+      options.max_threads = strcmp(argv[1], "auto") == 0 ? sizing_server_threads(options.state_access_delay_ms)
+                                                          : atoi(argv[1]);
+      if (options.max_threads <= 0) {
+          fprintf(stderr, "Invalid value for maximum threads\n");
+          return 1;
+      }
+      return run_server(&options);
+  }
+
+  if (argc == 4 || argc == 5) {
+      jobs_directory = argv[1];
 
       // Check if there's an optional delay argument
-      char *endptr;
-      unsigned long int delay = strtoul(argv[4], &endptr, 10);
+      if (argc == 5) {
+          char *endptr;
+          unsigned long int delay = strtoul(argv[4], &endptr, 10);
 
-      if (*endptr == '\0' && delay <= UINT_MAX) {
-          state_access_delay_ms = (unsigned int)delay;
-      } else {
-          fprintf(stderr, "Invalid delay value or value too large\n");
-          return 1;
+          if (*endptr == '\0' && delay <= UINT_MAX) {
+              options.state_access_delay_ms = (unsigned int)delay;
+          } else {
+              fprintf(stderr, "Invalid delay value or value too large\n");
+              return 1;
+          }
       }
   } else {
-      fprintf(stderr, "Usage: %s <jobs_directory> <max_processes> <max_threads> [delay]\n", argv[0]);
+      usage(program);
       return 1;
   }
-  int max_threads = atoi(argv[3]);
-  if (max_threads <= 0) {
+  // "auto" is left as 0 until the job files are known.
+  int auto_threads = strcmp(argv[3], "auto") == 0;
+  int max_threads = auto_threads ? 0 : atoi(argv[3]);
+  if (max_threads <= 0 && !auto_threads) {
       fprintf(stderr, "Invalid value for maximum processes or threads\n");
       return 1;
   }
-  int max_processes = atoi(argv[2]);
-  if (max_processes <= 0) {
+  int auto_processes = strcmp(argv[2], "auto") == 0;
+  int max_processes = auto_processes ? 0 : atoi(argv[2]);
+  if (max_processes <= 0 && !auto_processes) {
       fprintf(stderr, "Invalid value for maximum processes\n");
       return 1;
   }
-
-  if (ems_init(state_access_delay_ms)) {
-      fprintf(stderr, "Failed to initialize EMS\n");
-      return 1;
+  if (auto_processes || auto_threads) {
+      struct Workload workload;
+      if (sizing_scan(jobs_directory, &workload) != 0) {
+          return 1;
+      }
+      sizing_choose(&workload, options.state_access_delay_ms, &max_processes, &max_threads);
   }
+  options.max_threads = max_threads;
+  options.max_processes = max_processes;
+
   // Open JOBS directory
   DIR *dir = opendir(jobs_directory);
   if (!dir) {
@@ -360,6 +947,22 @@ int main(int argc, char *argv[]) {
       return 1;
   }
 
+  if (options.pin) {
+      if (affinity_init() != 0) {
+          fprintf(stderr, "Running without CPU placement\n");
+          options.pin = 0;
+      } else {
+          affinity_report((unsigned int)max_processes, (unsigned int)max_threads);
+      }
+  }
+  // Process running in each slot, 0 if free. A slot keeps its cores across the processes that use it.
+  pid_t *slots = calloc((size_t)max_processes, sizeof(pid_t));
+  if (!slots) {
+      fprintf(stderr, "Error allocating memory for processes\n");
+      closedir(dir);
+      return 1;
+  }
+
   struct dirent *entry;
   int active_processes = 0;
   int status;
@@ -371,18 +974,29 @@ int main(int argc, char *argv[]) {
             return 1;
         }
         active_processes--;
+        for (int i = 0; i < max_processes; ++i) {
+            if (slots[i] == finished_pid) slots[i] = 0;
+        }
     }
 
+    int slot = 0;
+    while (slots[slot] != 0) {
+        slot++;
+    }
     pid_t pid = fork();
     if (pid == -1) {
         perror("Error forking process");
         return 1;
     } else if (pid == 0) {
         // Child process
-        process_job_file(jobs_directory, entry->d_name, max_threads);
+        if (options.pin) {
+            affinity_pin_process((unsigned int)slot, (unsigned int)max_processes);
+        }
+        process_job_file(jobs_directory, entry->d_name, &options);
         exit(0);
     } else {
         // Parent process
+        slots[slot] = pid;
         active_processes++;
     }
   
@@ -405,7 +1019,7 @@ int main(int argc, char *argv[]) {
     
   }
   // end of program
+  free(slots);
   closedir(dir);
-  ems_terminate();
   return 0;
 }
\ No newline at end of file
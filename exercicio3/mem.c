@@ -0,0 +1,108 @@
+#include "mem.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Prefix of every block, recording what to take off the statistics when the block is freed.
+union MemHeader {
+  struct {
+    size_t size;
+    enum MemCategory category;
+  } block;
+  max_align_t align;  // Keeps the block that follows aligned like one from malloc
+};
+
+// Updated without locks, so that accounting never serializes the threads that allocate.
+struct MemCounters {
+  atomic_size_t bytes;
+  atomic_size_t peak;
+  atomic_size_t blocks;
+};
+
+static struct MemCounters counters[MEM_CATEGORIES + 1];  // Last one for every category together
+
+static const char* const category_names[MEM_CATEGORIES] = {"event headers", "seat grids", "event list",
+                                                           "reservations", "command buffers"};
+
+static void raise_peak(struct MemCounters* counter, size_t bytes) {
+  size_t peak = atomic_load_explicit(&counter->peak, memory_order_relaxed);
+  while (bytes > peak &&
+         !atomic_compare_exchange_weak_explicit(&counter->peak, &peak, bytes, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+static void account(enum MemCategory category, size_t size, int blocks) {
+  struct MemCounters* updated[2] = {&counters[category], &counters[MEM_CATEGORIES]};
+  for (size_t i = 0; i < 2; i++) {
+    if (blocks > 0) {
+      size_t bytes = atomic_fetch_add_explicit(&updated[i]->bytes, size, memory_order_relaxed) + size;
+      atomic_fetch_add_explicit(&updated[i]->blocks, 1, memory_order_relaxed);
+      raise_peak(updated[i], bytes);
+    } else {
+      atomic_fetch_sub_explicit(&updated[i]->bytes, size, memory_order_relaxed);
+      atomic_fetch_sub_explicit(&updated[i]->blocks, 1, memory_order_relaxed);
+    }
+  }
+}
+
+/// Records a block just allocated and returns the memory that follows its header.
+static void* track(union MemHeader* header, enum MemCategory category, size_t size) {
+  if (header == NULL) return NULL;
+  header->block.size = size;
+  header->block.category = category;
+  account(category, size, 1);
+  return header + 1;
+}
+
+void* mem_malloc(enum MemCategory category, size_t size) {
+  if (size > SIZE_MAX - sizeof(union MemHeader)) return NULL;
+  return track(malloc(sizeof(union MemHeader) + size), category, size);
+}
+
+void* mem_calloc(enum MemCategory category, size_t count, size_t size) {
+  if (size != 0 && count > (SIZE_MAX - sizeof(union MemHeader)) / size) return NULL;
+  return track(calloc(1, sizeof(union MemHeader) + count * size), category, count * size);
+}
+
+void* mem_realloc(enum MemCategory category, void* ptr, size_t size) {
+  if (ptr == NULL) return mem_malloc(category, size);
+  if (size > SIZE_MAX - sizeof(union MemHeader)) return NULL;
+
+  union MemHeader* header = (union MemHeader*)ptr - 1;
+  size_t old_size = header->block.size;
+  union MemHeader* resized = realloc(header, sizeof(union MemHeader) + size);
+  if (resized == NULL) return NULL;
+
+  // Accounted as a new block replacing the old one, so that the peak includes growth.
+  account(category, old_size, -1);
+  return track(resized, category, size);
+}
+
+void mem_free(void* ptr) {
+  if (ptr == NULL) return;
+  union MemHeader* header = (union MemHeader*)ptr - 1;
+  account(header->block.category, header->block.size, -1);
+  free(header);
+}
+
+void mem_usage(enum MemCategory category, struct MemUsage* usage) {
+  usage->bytes = atomic_load_explicit(&counters[category].bytes, memory_order_relaxed);
+  usage->peak = atomic_load_explicit(&counters[category].peak, memory_order_relaxed);
+  usage->blocks = atomic_load_explicit(&counters[category].blocks, memory_order_relaxed);
+}
+
+int mem_render(struct Buffer* output) {
+  char line[128];
+  struct MemUsage usage;
+  for (int category = 0; category <= MEM_CATEGORIES; category++) {
+    mem_usage((enum MemCategory)category, &usage);
+    int length = snprintf(line, sizeof(line), "%s: %zu bytes in %zu blocks, peak %zu bytes\n",
+                          category < MEM_CATEGORIES ? category_names[category] : "total", usage.bytes, usage.blocks,
+                          usage.peak);
+    if (buffer_append(output, line, (size_t)length) != 0) return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef EMS_MEM_H
+#define EMS_MEM_H
+
+#include <stddef.h>
+
+#include "buffer.h"
+
+// What the memory of the state is used for.
+enum MemCategory {
+  MEM_EVENTS,        // Event headers
+  MEM_SEATS,         // Seat grids, sparse rows and free-run trees
+  MEM_LIST,          // Event list, its nodes and index
+  MEM_RESERVATIONS,  // Reservation logs and the seats of each reservation
+  MEM_COMMANDS,      // Buffers holding the arguments of a command while it runs
+  MEM_CATEGORIES     // Number of categories
+};
+
+// Allocation statistics of a category, or of every category together.
+struct MemUsage {
+  size_t bytes;   // Bytes in use
+  size_t peak;    // Most bytes in use at any time
+  size_t blocks;  // Blocks in use
+};
+
+/// Same as malloc, accounting the block to a category.
+void* mem_malloc(enum MemCategory category, size_t size);
+
+/// Same as calloc, accounting the block to a category.
+void* mem_calloc(enum MemCategory category, size_t count, size_t size);
+
+/// Same as realloc, accounting the block to a category.
+/// @note ptr must be NULL or have been allocated by this module, in the same category.
+void* mem_realloc(enum MemCategory category, void* ptr, size_t size);
+
+/// Same as free, for blocks allocated by this module.
+void mem_free(void* ptr);
+
+/// Gets the statistics of a category.
+/// @param category Category, MEM_CATEGORIES for every category together.
+/// @param usage Pointer to the statistics to be filled.
+void mem_usage(enum MemCategory category, struct MemUsage* usage);
+
+/// Renders the statistics of every category, one per line, followed by the total.
+/// @param output Buffer to append the statistics to.
+/// @return 0 if the statistics were rendered successfully, 1 otherwise.
+int mem_render(struct Buffer* output);
+
+#endif  // EMS_MEM_H
@@ -1,14 +1,41 @@
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <unistd.h>
 #include <fcntl.h>
+#include "buffer.h"
+#include "constants.h"
+#include "epoch.h"
 #include "eventlist.h"
+#include "mem.h"
+#include "operations.h"
+#include "pool.h"
+#include "seatmap.h"
+#include "snapshot.h"
+#include "wal.h"
 
 static struct EventList* event_list = NULL;
 static unsigned int state_access_delay_ms = 0;
 
+// Ready-to-write output of LIST, appended to on every successful CREATE and rebuilt on every DELETE.
+static struct Buffer list_output;
+static pthread_mutex_t list_output_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Held by CREATE and DELETE from the lookup to the update of the list, so that they reach the log in the
+// order they take effect.
+static pthread_mutex_t directory_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Checkpointing: mutations hold the lock as readers, a checkpoint holds it as the writer.
+static pthread_rwlock_t checkpoint_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;  // Held by the thread taking a checkpoint
+static struct Snapshot snapshot;      // Snapshot the state was loaded from
+static char snapshot_path[4096];      // Empty if the state is not persisted
+static uint32_t wal_generation = 0;  // Generation of the current log
+
 
 static void cleanup(int fd) {
   char ch;
@@ -22,6 +49,22 @@ static struct timespec delay_to_timespec(unsigned int delay_ms) {
   return (struct timespec){delay_ms / 1000, (delay_ms % 1000) * 1000000};
 }
 
+/// Makes room in the reservation log for the reservation being created.
+/// @param event Event whose log is grown, must be locked by the caller.
+/// @return 0 if the log has room for event->reservations entries, 1 on allocation failure.
+static int reserve_log_entry(struct Event* event) {
+  if (snapshot_load_log(event) != 0) return 1;
+  if (event->reservations <= event->log_capacity) return 0;
+
+  size_t capacity = event->log_capacity ? event->log_capacity * 2 : 16;
+  struct Reservation* log = mem_realloc(MEM_RESERVATIONS, event->reservation_log, capacity * sizeof(struct Reservation));
+  if (log == NULL) return 1;
+
+  event->reservation_log = log;
+  event->log_capacity = capacity;
+  return 0;
+}
+
 /// Gets the event with the given ID from the state.
 /// @note Will wait to simulate a real system accessing a costly memory resource.
 /// @param event_id The ID of the event to get.
@@ -33,16 +76,132 @@ static struct Event* get_event_with_delay(unsigned int event_id) {
   return get_event(event_list, event_id);
 }
 
+/// Locks an event found by a lookup, unless it was deleted since.
+/// @param event Event to be locked.
+/// @return 0 if the event is locked, 1 if it was deleted (it is left unlocked).
+static int lock_event(struct Event* event) {
+  pthread_mutex_lock(&event->lock);
+  if (!event->deleted) return 0;
+
+  pthread_mutex_unlock(&event->lock);
+  fprintf(stderr, "Event not found\n");
+  return 1;
+}
+
+/// Largest reservation id that fits in a seat of the given width.
+/// @param width Bytes per seat.
+/// @return Largest storable value.
+static unsigned int seat_width_limit(unsigned char width) {
+  switch (width) {
+    case 1:
+      return UINT8_MAX;
+    case 2:
+      return UINT16_MAX;
+    default:
+      return UINT32_MAX;
+  }
+}
+
+/// Reads a seat regardless of the width the event currently stores seats in.
+/// @param event Event to read the seat from.
+/// @param index Index of the seat.
+/// @return Reservation id of the seat, 0 if free.
+static unsigned int seat_load(const struct Event* event, size_t index) {
+  if (event->sparse_rows) {
+    return sparse_row_get(&event->sparse_rows[index / event->cols], index % event->cols);
+  }
+
+  switch (event->seat_width) {
+    case 1:
+      return ((const uint8_t*)event->data)[index];
+    case 2:
+      return ((const uint16_t*)event->data)[index];
+    default:
+      return ((const uint32_t*)event->data)[index];
+  }
+}
+
+/// Writes a seat regardless of the width the event currently stores seats in.
+/// @note The value must fit in the current width, see widen_seats.
+/// @param event Event to write the seat to.
+/// @param index Index of the seat.
+/// @param value Reservation id to store.
+/// @return 0 if the seat was written, 1 on allocation failure (sparse events only).
+static int seat_store(struct Event* event, size_t index, unsigned int value) {
+  if (event->sparse_rows) {
+    return sparse_row_set(&event->sparse_rows[index / event->cols], index % event->cols, value);
+  }
+
+  switch (event->seat_width) {
+    case 1:
+      ((uint8_t*)event->data)[index] = (uint8_t)value;
+      break;
+    case 2:
+      ((uint16_t*)event->data)[index] = (uint16_t)value;
+      break;
+    default:
+      ((uint32_t*)event->data)[index] = (uint32_t)value;
+      break;
+  }
+
+  if (event->free_runs) {
+    freerun_set(event->free_runs, index / event->cols, index % event->cols, value == 0);
+  }
+  return 0;
+}
+
+/// Converts the seats of an event to a wider element so that value can be stored.
+/// @param event Event to be modified.
+/// @param value Value that has to fit in the seats.
+/// @return 0 if the seats are wide enough, 1 on allocation failure.
+static int widen_seats(struct Event* event, unsigned int value) {
+  if (event->sparse_rows || value <= seat_width_limit(event->seat_width)) return 0;
+
+  unsigned char width = value <= UINT16_MAX ? 2 : 4;
+  size_t num_seats = event->rows * event->cols;
+  void* data = mem_malloc(MEM_SEATS, num_seats * width);
+  if (data == NULL) return 1;
+
+  struct Event widened = *event;
+  widened.seat_width = width;
+  widened.data = data;
+  widened.free_runs = NULL;
+  for (size_t i = 0; i < num_seats; i++) {
+    seat_store(&widened, i, seat_load(event, i));
+  }
+
+  if (!event->data_mapped) {
+    mem_free(event->data);
+  }
+  event->data = data;
+  event->data_mapped = 0;
+  event->seat_width = width;
+  return 0;
+}
+
 /// Gets the seat with the given index from the state.
 /// @note Will wait to simulate a real system accessing a costly memory resource.
 /// @param event Event to get the seat from.
 /// @param index Index of the seat to get.
-/// @return Pointer to the seat.
-static unsigned int* get_seat_with_delay(struct Event* event, size_t index) {
+/// @return Reservation id of the seat, 0 if free.
+static unsigned int get_seat_with_delay(const struct Event* event, size_t index) {
   struct timespec delay = delay_to_timespec(state_access_delay_ms);
   nanosleep(&delay, NULL);  // Should not be removed
 
-  return &event->data[index];
+  return seat_load(event, index);
+}
+
+/// Sets the seat with the given index in the state.
+/// @note Will wait to simulate a real system accessing a costly memory resource.
+/// @param event Event to set the seat in.
+/// @param index Index of the seat to set.
+/// @param value Reservation id to store, 0 to free the seat.
+/// @return 0 if the seat was set, 1 otherwise.
+static int set_seat_with_delay(struct Event* event, size_t index, unsigned int value) {
+  struct timespec delay = delay_to_timespec(state_access_delay_ms);
+  nanosleep(&delay, NULL);  // Should not be removed
+
+  return seat_store(event, index, value);
 }
 
 /// Gets the index of a seat.
@@ -53,16 +212,187 @@ static unsigned int* get_seat_with_delay(struct Event* event, size_t index) {
 /// @return Index of the seat.
 static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
 
-int ems_init(unsigned int delay_ms) {
+/// Waits for a logged operation to be durable, warning if the log could not store it.
+/// @param lsn Sequence number of the record, 0 if nothing was logged.
+static void wait_durable(uint64_t lsn) {
+  if (wal_wait(lsn) != 0) {
+    fprintf(stderr, "Operation may not be durable\n");
+  }
+}
+
+/// Appends a reservation in the WAL_RESERVE layout to an array of log fields.
+/// @return Number of fields written.
+static size_t reservation_fields(uint32_t* fields, unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  size_t n = 0;
+  fields[n++] = event_id;
+  fields[n++] = (uint32_t)num_seats;
+  for (size_t i = 0; i < num_seats; i++) {
+    fields[n++] = (uint32_t)xs[i];
+    fields[n++] = (uint32_t)ys[i];
+  }
+  return n;
+}
+
+/// Logs a reservation that was just created.
+/// @return Sequence number of the record, 0 if the log is disabled.
+static uint64_t log_reservation(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  uint32_t* fields = mem_malloc(MEM_COMMANDS, (2 + 2 * num_seats) * sizeof(uint32_t));
+  if (fields == NULL) {
+    fprintf(stderr, "Error allocating memory for log record\n");
+    return 0;
+  }
+
+  uint64_t lsn = wal_append(WAL_RESERVE, fields, reservation_fields(fields, event_id, num_seats, xs, ys));
+  mem_free(fields);
+  return lsn;
+}
+
+/// Reads the coordinates of a WAL_RESERVE payload.
+/// @return Number of fields used by the payload, 0 if it is malformed or could not be read.
+static size_t parse_reservation_fields(const uint32_t* fields, size_t num_fields, size_t* xs, size_t* ys) {
+  if (num_fields < 2 || fields[1] == 0 || (num_fields - 2) / 2 < fields[1]) return 0;
+
+  for (size_t i = 0; i < fields[1]; i++) {
+    xs[i] = fields[2 + 2 * i];
+    ys[i] = fields[3 + 2 * i];
+  }
+  return 2 + 2 * (size_t)fields[1];
+}
+
+/// Applies a record of the log to the state, see wal_replay.
+static int replay_record(enum WalRecordType type, const uint32_t* fields, size_t num_fields) {
+  size_t* xs = mem_malloc(MEM_COMMANDS, (num_fields / 2 + 1) * sizeof(size_t));
+  size_t* ys = mem_malloc(MEM_COMMANDS, (num_fields / 2 + 1) * sizeof(size_t));
+  unsigned int* event_ids = mem_malloc(MEM_COMMANDS, (num_fields / 2 + 1) * sizeof(unsigned int));
+  size_t* num_seats = mem_malloc(MEM_COMMANDS, (num_fields / 2 + 1) * sizeof(size_t));
+  int result = 1;
+
+  if (xs == NULL || ys == NULL || event_ids == NULL || num_seats == NULL) {
+    fprintf(stderr, "Error allocating memory for log replay\n");
+  } else if (type == WAL_CREATE && num_fields == 3) {
+    result = ems_create(fields[0], fields[1], fields[2]);
+  } else if (type == WAL_RESERVE && parse_reservation_fields(fields, num_fields, xs, ys) == num_fields) {
+    result = ems_reserve(fields[0], fields[1], xs, ys);
+  } else if (type == WAL_CANCEL && num_fields == 2) {
+    result = ems_cancel(fields[0], fields[1]);
+  } else if (type == WAL_DELETE && num_fields == 1) {
+    result = ems_delete(fields[0]);
+  } else if (type == WAL_RESERVE_MULTI && num_fields > 0) {
+    size_t used = 1, total = 0, n = 0;
+    for (; n < fields[0] && used < num_fields; n++) {
+      size_t size = parse_reservation_fields(fields + used, num_fields - used, xs + total, ys + total);
+      if (size == 0) break;
+      event_ids[n] = fields[used];
+      num_seats[n] = fields[used + 1];
+      total += num_seats[n];
+      used += size;
+    }
+    if (n == fields[0] && used == num_fields) {
+      result = ems_reserve_multi(n, event_ids, num_seats, xs, ys);
+    }
+  }
+
+  mem_free(xs);
+  mem_free(ys);
+  mem_free(event_ids);
+  mem_free(num_seats);
+  return result;
+}
+
+/// Makes an event visible to lookups and to LIST.
+/// @param event Event to be published, owned by the list on success.
+/// @return 0 if the event was published, 1 otherwise.
+static int publish_event(struct Event* event) {
+  if (append_to_list(event_list, event) != 0) {
+    fprintf(stderr, "Error appending event to list\n");
+    return 1;
+  }
+
+  pthread_mutex_lock(&list_output_mutex);
+  if (buffer_append(&list_output, "Event: ", 7) != 0 || buffer_append_uint(&list_output, event->id) != 0 ||
+      buffer_append(&list_output, "\n", 1) != 0) {
+    fprintf(stderr, "Error updating event listing\n");
+  }
+  pthread_mutex_unlock(&list_output_mutex);
+  return 0;
+}
+
+/// Writes a snapshot of the whole state and starts a new, empty log generation.
+/// @return 0 if the checkpoint was taken, 1 otherwise (the log keeps growing).
+static int checkpoint() {
+  pthread_rwlock_wrlock(&checkpoint_lock);
+
+  uint64_t wal_size;
+  int result = wal_sync(&wal_size) != 0 || snapshot_write(snapshot_path, event_list, wal_generation, wal_size) != 0;
+  // A crash between the snapshot and the rotation replays the old log from wal_size on, which is empty.
+  if (result == 0 && wal_rotate(wal_generation + 1) == 0) {
+    wal_generation++;
+  }
+
+  pthread_rwlock_unlock(&checkpoint_lock);
+  return result;
+}
+
+/// Takes a checkpoint once enough records have been logged since the last one.
+/// @note Must be called without holding any event lock.
+static void maybe_checkpoint() {
+  if (snapshot_path[0] == '\0' || wal_records() < CHECKPOINT_INTERVAL_RECORDS) return;
+
+  // Only one thread takes the checkpoint, the others carry on.
+  if (pthread_mutex_trylock(&checkpoint_mutex) != 0) return;
+  if (wal_records() >= CHECKPOINT_INTERVAL_RECORDS && checkpoint() != 0) {
+    fprintf(stderr, "Error taking checkpoint\n");
+  }
+  pthread_mutex_unlock(&checkpoint_mutex);
+}
+
+/// Frees the events recovered so far and the snapshot they were mapped from, after a failed recovery.
+static void discard_recovery() {
+  free_list(event_list);
+  event_list = NULL;
+  snapshot_unmap(&snapshot);
+  snapshot_path[0] = '\0';
+  buffer_free(&list_output);
+}
+
+int ems_init(unsigned int delay_ms, const char* wal_path, unsigned int flush_interval_ms, unsigned int show_threads) {
   if (event_list != NULL) {
     fprintf(stderr, "EMS state has already been initialized\n");
     return 1;
   }
 
   event_list = create_list();
-  state_access_delay_ms = delay_ms;
+  buffer_init(&list_output);
+  snapshot_path[0] = '\0';
+  if (event_list == NULL) return 1;
 
-  return event_list == NULL;
+  if (wal_path != NULL) {
+    // The snapshot sits next to the log: events.wal -> events.snap
+    size_t length = strlen(wal_path);
+    if (length >= 4 && strcmp(wal_path + length - 4, ".wal") == 0) length -= 4;
+    snprintf(snapshot_path, sizeof(snapshot_path), "%.*s.snap", (int)length, wal_path);
+
+    // Recovery rebuilds the state, it does not simulate client accesses.
+    state_access_delay_ms = 0;
+    int generation_matched;
+    if (snapshot_load(snapshot_path, &snapshot, publish_event) != 0 ||
+        wal_replay(wal_path, snapshot.generation, snapshot.wal_offset, replay_record, &generation_matched) < 0) {
+      fprintf(stderr, "Error recovering state from log\n");
+      discard_recovery();
+      return 1;
+    }
+
+    // A log from another generation was already emptied by a checkpoint, or predates the snapshot.
+    wal_generation = generation_matched ? snapshot.generation : snapshot.generation + 1;
+    if (wal_open(wal_path, flush_interval_ms, wal_generation) != 0) {
+      fprintf(stderr, "Error recovering state from log\n");
+      discard_recovery();
+      return 1;
+    }
+  }
+
+  state_access_delay_ms = delay_ms;
+  return pool_start(show_threads);
 }
 
 int ems_terminate() {
@@ -71,9 +401,25 @@ int ems_terminate() {
     return 1;
   }
 
+  // The next start only has to map the snapshot.
+  if (snapshot_path[0] != '\0' && wal_records() > 0 && checkpoint() != 0) {
+    fprintf(stderr, "Error taking checkpoint\n");
+  }
+
+  pool_stop();
+  wal_close();
   free_list(event_list);
+  epoch_drain();
+  event_list = NULL;
+  snapshot_unmap(&snapshot);
+  snapshot_path[0] = '\0';
+
+  pthread_mutex_lock(&list_output_mutex);
+  buffer_free(&list_output);
+  pthread_mutex_unlock(&list_output_mutex);
   return 0;
 }
+
 int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
@@ -85,7 +431,7 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
     return 1;
   }
 
-  struct Event* event = malloc(sizeof(struct Event));
+  struct Event* event = mem_malloc(MEM_EVENTS, sizeof(struct Event));
 
   if (event == NULL) {
     fprintf(stderr, "Error allocating memory for event\n");
@@ -96,135 +442,838 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   event->rows = num_rows;
   event->cols = num_cols;
   event->reservations = 0;
-  event->data = malloc(num_rows * num_cols * sizeof(unsigned int));
+  event->seat_width = 1;
+  event->data = NULL;
+  event->data_mapped = 0;
+  event->sparse_rows = NULL;
+  event->reservation_log = NULL;
+  event->log_capacity = 0;
+  event->snapshot_log = NULL;
+  event->free_runs = NULL;
+  event->deleted = 0;
 
-  if (event->data == NULL) {
+  // Huge venues only store the seats that get sold.
+  if (num_rows * num_cols > SPARSE_SEAT_THRESHOLD) {
+    event->sparse_rows = mem_calloc(MEM_SEATS, num_rows, sizeof(struct SeatRow));
+  } else {
+    event->data = mem_calloc(MEM_SEATS, num_rows * num_cols, event->seat_width);
+  }
+
+  if (event->data == NULL && event->sparse_rows == NULL) {
     fprintf(stderr, "Error allocating memory for event data\n");
-    free(event);
+    mem_free(event);
     return 1;
   }
 
-  for (size_t i = 0; i < num_rows * num_cols; i++) {
-    event->data[i] = 0;
+  pthread_mutex_init(&event->lock, NULL);
+
+  pthread_rwlock_rdlock(&checkpoint_lock);
+  pthread_mutex_lock(&directory_mutex);
+  // Checked again, as a concurrent CREATE of the same id may have won since the first lookup.
+  int exists = get_event(event_list, event_id) != NULL;
+  uint64_t lsn = 0;
+  if (!exists) {
+    // Logged before the event becomes visible, so its reservations can never precede it in the log.
+    uint32_t fields[3] = {event_id, (uint32_t)num_rows, (uint32_t)num_cols};
+    lsn = wal_append(WAL_CREATE, fields, 3);
   }
 
-  if (append_to_list(event_list, event) != 0) {
-    fprintf(stderr, "Error appending event to list\n");
-    free(event->data);
-    free(event);
+  if (exists || publish_event(event) != 0) {
+    pthread_mutex_unlock(&directory_mutex);
+    pthread_rwlock_unlock(&checkpoint_lock);
+    if (exists) {
+      fprintf(stderr, "Event already exists\n");
+    }
+    pthread_mutex_destroy(&event->lock);
+    mem_free(event->sparse_rows);
+    mem_free(event->data);
+    mem_free(event);
+    return 1;
+  }
+  pthread_mutex_unlock(&directory_mutex);
+  pthread_rwlock_unlock(&checkpoint_lock);
+
+  wait_durable(lsn);
+  maybe_checkpoint();
+  return 0;
+}
+
+/// Checks that the given seats exist, are free and are not repeated.
+/// @param event Event the seats belong to, must be locked by the caller.
+/// @param num_seats Number of seats to check.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return 0 if every seat can be reserved, 1 otherwise.
+static int validate_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
+  for (size_t i = 0; i < num_seats; i++) {
+    size_t row = xs[i];
+    size_t col = ys[i];
+
+    if (row <= 0 || row > event->rows || col <= 0 || col > event->cols) {
+      fprintf(stderr, "Invalid seat\n");
+      return 1;
+    }
+
+    if (get_seat_with_delay(event, seat_index(event, row, col)) != 0) {
+      fprintf(stderr, "Seat already reserved\n");
+      return 1;
+    }
+
+    for (size_t j = 0; j < i; j++) {
+      if (xs[j] == row && ys[j] == col) {
+        fprintf(stderr, "Seat already reserved\n");
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/// Writes validated seats as a new reservation.
+/// @param event Event to reserve seats in, must be locked by the caller.
+/// @param num_seats Number of seats to reserve.
+/// @param xs Array of rows of the seats, see validate_seats.
+/// @param ys Array of columns of the seats, see validate_seats.
+/// @return 0 if the reservation was created successfully, 1 if it was rolled back.
+static int commit_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
+  unsigned int reservation_id = ++event->reservations;
+  size_t* seats = mem_malloc(MEM_RESERVATIONS, num_seats * sizeof(size_t));
+
+  if (seats == NULL || widen_seats(event, reservation_id) != 0 || reserve_log_entry(event) != 0) {
+    fprintf(stderr, "Error allocating memory for event data\n");
+    event->reservations--;
+    mem_free(seats);
     return 1;
   }
 
+  for (size_t i = 0; i < num_seats; i++) {
+    seats[i] = seat_index(event, xs[i], ys[i]);
+    if (set_seat_with_delay(event, seats[i], reservation_id) != 0) {
+      fprintf(stderr, "Error allocating memory for event data\n");
+      event->reservations--;
+      for (size_t j = 0; j < i; j++) {
+        set_seat_with_delay(event, seats[j], 0);
+      }
+      mem_free(seats);
+      return 1;
+    }
+  }
+
+  event->reservation_log[reservation_id - 1] = (struct Reservation){num_seats, seats};
   return 0;
 }
 
+/// Rolls back the latest reservation of an event, giving its id back.
+/// @param event Event to be modified, must be locked by the caller.
+static void undo_last_reservation(struct Event* event) {
+  struct Reservation* reservation = &event->reservation_log[event->reservations - 1];
+  for (size_t i = 0; i < reservation->num_seats; i++) {
+    set_seat_with_delay(event, reservation->seats[i], 0);
+  }
+  mem_free(reservation->seats);
+  event->reservations--;
+}
+
+/// Reserves the given seats of an event as a new reservation, or none of them.
+/// @param event Event to reserve seats in, must be locked by the caller.
+/// @param num_seats Number of seats to reserve.
+/// @param xs Array of rows of the seats to reserve.
+/// @param ys Array of columns of the seats to reserve.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+static int reserve_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
+  if (validate_seats(event, num_seats, xs, ys) != 0) return 1;
+
+  return commit_seats(event, num_seats, xs, ys);
+}
+
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
+  // Keeps the event from being freed by a concurrent DELETE while it is used.
+  epoch_enter();
   struct Event* event = get_event_with_delay(event_id);
 
   if (event == NULL) {
     fprintf(stderr, "Event not found\n");
+    epoch_exit();
     return 1;
   }
 
-  unsigned int reservation_id = ++event->reservations;
+  pthread_rwlock_rdlock(&checkpoint_lock);
+  if (lock_event(event) != 0) {
+    pthread_rwlock_unlock(&checkpoint_lock);
+    epoch_exit();
+    return 1;
+  }
+  int result = reserve_seats(event, num_seats, xs, ys);
+  uint64_t lsn = result == 0 ? log_reservation(event_id, num_seats, xs, ys) : 0;
+  pthread_mutex_unlock(&event->lock);
+  pthread_rwlock_unlock(&checkpoint_lock);
+  epoch_exit();
 
-  size_t i = 0;
-  for (; i < num_seats; i++) {
-    size_t row = xs[i];
-    size_t col = ys[i];
+  wait_durable(lsn);
+  maybe_checkpoint();
+  return result;
+}
 
-    if (row <= 0 || row > event->rows || col <= 0 || col > event->cols) {
-      fprintf(stderr, "Invalid seat\n");
-      break;
-    }
+int ems_reserve_batch(unsigned int event_id, size_t num_requests, size_t* num_seats, size_t* xs, size_t* ys,
+                      int* results) {
+  for (size_t i = 0; i < num_requests; i++) {
+    results[i] = 1;
+  }
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
 
-    if (*get_seat_with_delay(event, seat_index(event, row, col)) != 0) {
-      fprintf(stderr, "Seat already reserved\n");
-      break;
+  // Keeps the event from being freed by a concurrent DELETE while it is used.
+  epoch_enter();
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    epoch_exit();
+    return 1;
+  }
+
+  pthread_rwlock_rdlock(&checkpoint_lock);
+  if (lock_event(event) != 0) {
+    pthread_rwlock_unlock(&checkpoint_lock);
+    epoch_exit();
+    return 1;
+  }
+  // Each reservation is logged on its own, so recovery replays them as if they were separate RESERVEs.
+  uint64_t lsn = 0;
+  size_t offset = 0;
+  for (size_t i = 0; i < num_requests; i++) {
+    results[i] = reserve_seats(event, num_seats[i], xs + offset, ys + offset);
+    if (results[i] == 0) {
+      uint64_t logged = log_reservation(event_id, num_seats[i], xs + offset, ys + offset);
+      lsn = logged > lsn ? logged : lsn;
     }
+    offset += num_seats[i];
+  }
+  pthread_mutex_unlock(&event->lock);
+  pthread_rwlock_unlock(&checkpoint_lock);
+  epoch_exit();
+
+  wait_durable(lsn);
+  maybe_checkpoint();
+  return 0;
+}
 
-    *get_seat_with_delay(event, seat_index(event, row, col)) = reservation_id;
+static int compare_events_by_id(const void* a, const void* b) {
+  unsigned int id_a = (*(struct Event* const*)a)->id;
+  unsigned int id_b = (*(struct Event* const*)b)->id;
+  return (id_a > id_b) - (id_a < id_b);
+}
+
+int ems_reserve_multi(size_t num_events, unsigned int* event_ids, size_t* num_seats, size_t* xs, size_t* ys) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
   }
 
-  // If the reservation was not successful, free the seats that were reserved.
-  if (i < num_seats) {
-    event->reservations--;
-    for (size_t j = 0; j < i; j++) {
-      *get_seat_with_delay(event, seat_index(event, xs[j], ys[j])) = 0;
+  struct Event** events = mem_malloc(MEM_COMMANDS, num_events * sizeof(struct Event*));
+  struct Event** locked = mem_malloc(MEM_COMMANDS, num_events * sizeof(struct Event*));
+  if (events == NULL || locked == NULL) {
+    fprintf(stderr, "Error allocating memory for reservation\n");
+    mem_free(events);
+    mem_free(locked);
+    return 1;
+  }
+
+  // Keeps the events from being freed by a concurrent DELETE while they are used.
+  epoch_enter();
+  int result = 0;
+  for (size_t i = 0; i < num_events && result == 0; i++) {
+    events[i] = get_event_with_delay(event_ids[i]);
+    if (events[i] == NULL) {
+      fprintf(stderr, "Event not found\n");
+      result = 1;
+    }
+  }
+
+  // Locks are always taken in event id order, so concurrent transactions cannot deadlock.
+  if (result == 0) {
+    memcpy(locked, events, num_events * sizeof(struct Event*));
+    qsort(locked, num_events, sizeof(struct Event*), compare_events_by_id);
+    for (size_t i = 1; i < num_events && result == 0; i++) {
+      if (locked[i] == locked[i - 1]) {
+        fprintf(stderr, "Event repeated in reservation\n");
+        result = 1;
+      }
     }
+  }
+
+  if (result != 0) {
+    epoch_exit();
+    mem_free(events);
+    mem_free(locked);
     return 1;
   }
 
+  pthread_rwlock_rdlock(&checkpoint_lock);
+  for (size_t i = 0; i < num_events; i++) {
+    pthread_mutex_lock(&locked[i]->lock);
+  }
+  for (size_t i = 0; i < num_events && result == 0; i++) {
+    if (locked[i]->deleted) {
+      fprintf(stderr, "Event not found\n");
+      result = 1;
+    }
+  }
+
+  size_t offset = 0;
+  for (size_t i = 0; i < num_events && result == 0; i++) {
+    result = validate_seats(events[i], num_seats[i], xs + offset, ys + offset);
+    offset += num_seats[i];
+  }
+
+  size_t committed = 0;
+  offset = 0;
+  for (; committed < num_events && result == 0; committed++) {
+    result = commit_seats(events[committed], num_seats[committed], xs + offset, ys + offset);
+    offset += num_seats[committed];
+  }
+
+  // Abort: every event goes back to the state it had before the transaction.
+  if (result != 0 && committed > 0) {
+    for (size_t i = 0; i < committed - 1; i++) {
+      undo_last_reservation(events[i]);
+    }
+  }
+
+  // The whole transaction is a single record, so recovery never sees half of it.
+  uint64_t lsn = 0;
+  uint32_t* fields = result == 0 ? mem_malloc(MEM_COMMANDS, (1 + 2 * num_events + 2 * offset) * sizeof(uint32_t)) : NULL;
+  if (fields != NULL) {
+    size_t n = 0;
+    fields[n++] = (uint32_t)num_events;
+    offset = 0;
+    for (size_t i = 0; i < num_events; i++) {
+      n += reservation_fields(fields + n, event_ids[i], num_seats[i], xs + offset, ys + offset);
+      offset += num_seats[i];
+    }
+    lsn = wal_append(WAL_RESERVE_MULTI, fields, n);
+    mem_free(fields);
+  }
+
+  for (size_t i = num_events; i > 0; i--) {
+    pthread_mutex_unlock(&locked[i - 1]->lock);
+  }
+  pthread_rwlock_unlock(&checkpoint_lock);
+  epoch_exit();
+
+  wait_durable(lsn);
+  maybe_checkpoint();
+  mem_free(events);
+  mem_free(locked);
+  return result;
+}
+
+/// Builds the free run summaries of a dense event from its seats.
+/// @param event Event to be indexed, must be locked by the caller.
+/// @return 0 if the summaries are available, 1 otherwise.
+static int build_free_runs(struct Event* event) {
+  if (event->free_runs) return 0;
+
+  event->free_runs = freerun_create(event->rows, event->cols);
+  if (event->free_runs == NULL) return 1;
+
+  for (size_t i = 0; i < event->rows * event->cols; i++) {
+    if (seat_load(event, i) != 0) {
+      freerun_mark_taken(event->free_runs, i / event->cols, i % event->cols);
+    }
+  }
+  freerun_rebuild(event->free_runs);
   return 0;
 }
 
-int ems_show(unsigned int event_id, int fd) {
+/// Finds the best available seats of a sparse event by walking the gaps between its runs.
+/// @param event Event to be searched, must be locked by the caller.
+/// @param num_seats Number of seats wanted.
+/// @param contiguous Whether the seats must be adjacent in a single row.
+/// @param xs Array to store the rows (1-based) in.
+/// @param ys Array to store the columns (1-based) in.
+/// @return 0 if the seats were found, 1 otherwise.
+static int find_sparse_seats(struct Event* event, size_t num_seats, int contiguous, size_t* xs, size_t* ys) {
+  size_t found = 0;
+  for (size_t row = 0; row < event->rows && found < num_seats; row++) {
+    const struct SeatRow* seat_row = &event->sparse_rows[row];
+    size_t col;
+
+    if (contiguous) {
+      if (sparse_row_find_run(seat_row, event->cols, num_seats, &col) == 0) {
+        for (; found < num_seats; found++) {
+          xs[found] = row + 1;
+          ys[found] = col + found + 1;
+        }
+      }
+      continue;
+    }
+
+    size_t added = sparse_row_free_seats(seat_row, event->cols, num_seats - found, ys + found);
+    for (size_t i = found; i < found + added; i++) {
+      xs[i] = row + 1;
+      ys[i]++;
+    }
+    found += added;
+  }
+  return found < num_seats;
+}
+
+/// Finds the best available seats of a dense event using its free run summaries.
+/// @param event Event to be searched, must be locked by the caller.
+/// @param num_seats Number of seats wanted.
+/// @param contiguous Whether the seats must be adjacent in a single row.
+/// @param xs Array to store the rows (1-based) in.
+/// @param ys Array to store the columns (1-based) in.
+/// @return 0 if the seats were found, 1 otherwise.
+static int find_dense_seats(struct Event* event, size_t num_seats, int contiguous, size_t* xs, size_t* ys) {
+  if (build_free_runs(event) != 0) return 1;
+
+  if (contiguous) {
+    size_t row, col;
+    if (freerun_find_run(event->free_runs, num_seats, &row, &col) != 0) return 1;
+    for (size_t i = 0; i < num_seats; i++) {
+      xs[i] = row + 1;
+      ys[i] = col + i + 1;
+    }
+    return 0;
+  }
+
+  if (freerun_find_seats(event->free_runs, num_seats, xs, ys) != 0) return 1;
+  for (size_t i = 0; i < num_seats; i++) {
+    xs[i]++;
+    ys[i]++;
+  }
+  return 0;
+}
+
+int ems_reserve_best(unsigned int event_id, size_t num_seats, int contiguous) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
+  // Keeps the event from being freed by a concurrent DELETE while it is used.
+  epoch_enter();
   struct Event* event = get_event_with_delay(event_id);
 
   if (event == NULL) {
     fprintf(stderr, "Event not found\n");
+    epoch_exit();
     return 1;
   }
-   char buffer[12];
-  for (size_t i = 1; i <= event->rows; i++) {
-    for (size_t j = 1; j <= event->cols; j++) {
-      unsigned int* seat = get_seat_with_delay(event, seat_index(event, i, j));
-      int len = snprintf(buffer, sizeof(buffer), "%u", *seat);
 
-      // Write the string to the file
-      write(fd, buffer, (size_t)len);
+  size_t* xs = mem_malloc(MEM_COMMANDS, num_seats * sizeof(size_t));
+  size_t* ys = mem_malloc(MEM_COMMANDS, num_seats * sizeof(size_t));
+  if (xs == NULL || ys == NULL) {
+    fprintf(stderr, "Error allocating memory for reservation\n");
+    mem_free(xs);
+    mem_free(ys);
+    epoch_exit();
+    return 1;
+  }
 
-      if (j < event->cols) {
-        write(fd, " ", 1);
-      }
-      
+  pthread_rwlock_rdlock(&checkpoint_lock);
+  if (lock_event(event) != 0) {
+    pthread_rwlock_unlock(&checkpoint_lock);
+    epoch_exit();
+    mem_free(xs);
+    mem_free(ys);
+    return 1;
+  }
+
+  int result;
+  if (event->sparse_rows) {
+    result = find_sparse_seats(event, num_seats, contiguous, xs, ys);
+  } else {
+    result = find_dense_seats(event, num_seats, contiguous, xs, ys);
+  }
+
+  uint64_t lsn = 0;
+  if (result != 0) {
+    fprintf(stderr, "Not enough free seats\n");
+  } else {
+    result = reserve_seats(event, num_seats, xs, ys);
+    // Logged with the seats that were picked, so that replay does not depend on the search.
+    lsn = result == 0 ? log_reservation(event_id, num_seats, xs, ys) : 0;
+  }
+
+  pthread_mutex_unlock(&event->lock);
+  pthread_rwlock_unlock(&checkpoint_lock);
+  epoch_exit();
+  wait_durable(lsn);
+  maybe_checkpoint();
+
+  mem_free(xs);
+  mem_free(ys);
+  return result;
+}
+
+/// Gets a live reservation of an event.
+/// @param event Event to search, must be locked by the caller.
+/// @param reservation_id Id of the reservation.
+/// @return Pointer to the reservation, NULL if it does not exist or was cancelled.
+static struct Reservation* find_reservation(struct Event* event, unsigned int reservation_id) {
+  if (reservation_id == 0 || reservation_id > event->reservations) return NULL;
+  if (snapshot_load_log(event) != 0) {
+    fprintf(stderr, "Error allocating memory for reservation\n");
+    return NULL;
+  }
+
+  struct Reservation* reservation = &event->reservation_log[reservation_id - 1];
+  return reservation->num_seats > 0 ? reservation : NULL;
+}
+
+int ems_render_query(unsigned int event_id, unsigned int reservation_id, struct Buffer* output) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Keeps the event from being freed by a concurrent DELETE while it is used.
+  epoch_enter();
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    epoch_exit();
+    return 1;
+  }
+
+  if (lock_event(event) != 0) {
+    epoch_exit();
+    return 1;
+  }
+
+  struct Reservation* reservation = find_reservation(event, reservation_id);
+  if (reservation == NULL) {
+    pthread_mutex_unlock(&event->lock);
+    epoch_exit();
+    fprintf(stderr, "Reservation not found\n");
+    return 1;
+  }
+
+  int result = buffer_append(output, "[", 1);
+  for (size_t i = 0; i < reservation->num_seats && result == 0; i++) {
+    size_t seat = reservation->seats[i];
+    result = (i > 0 && buffer_append(output, " ", 1) != 0) || buffer_append(output, "(", 1) != 0 ||
+             buffer_append_uint(output, (unsigned int)(seat / event->cols + 1)) != 0 ||
+             buffer_append(output, ",", 1) != 0 ||
+             buffer_append_uint(output, (unsigned int)(seat % event->cols + 1)) != 0 ||
+             buffer_append(output, ")", 1) != 0;
+  }
+
+  pthread_mutex_unlock(&event->lock);
+  epoch_exit();
+
+  return result || buffer_append(output, "]\n", 2) != 0;
+}
+
+int ems_query(unsigned int event_id, unsigned int reservation_id, int fd) {
+  struct Buffer output;
+  buffer_init(&output);
+  int result = ems_render_query(event_id, reservation_id, &output) != 0 || write_all(fd, output.data, output.len) != 0;
+  buffer_free(&output);
+  return result;
+}
+
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Keeps the event from being freed by a concurrent DELETE while it is used.
+  epoch_enter();
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    epoch_exit();
+    return 1;
+  }
+
+  pthread_rwlock_rdlock(&checkpoint_lock);
+  if (lock_event(event) != 0) {
+    pthread_rwlock_unlock(&checkpoint_lock);
+    epoch_exit();
+    return 1;
+  }
+
+  struct Reservation* reservation = find_reservation(event, reservation_id);
+  if (reservation == NULL) {
+    pthread_mutex_unlock(&event->lock);
+    pthread_rwlock_unlock(&checkpoint_lock);
+    epoch_exit();
+    fprintf(stderr, "Reservation not found\n");
+    return 1;
+  }
+
+  int result = 0;
+  for (size_t i = 0; i < reservation->num_seats; i++) {
+    if (set_seat_with_delay(event, reservation->seats[i], 0) != 0) {
+      result = 1;
     }
+  }
+
+  mem_free(reservation->seats);
+  reservation->seats = NULL;
+  reservation->num_seats = 0;
+
+  uint32_t fields[2] = {event_id, reservation_id};
+  uint64_t lsn = wal_append(WAL_CANCEL, fields, 2);
+
+  pthread_mutex_unlock(&event->lock);
+  pthread_rwlock_unlock(&checkpoint_lock);
+  epoch_exit();
+  wait_durable(lsn);
+  maybe_checkpoint();
+  return result;
+}
+
+/// Frees a deleted event, see epoch_retire.
+static void retire_event(void* event) { free_event(event); }
 
-    write(fd, "\n", 1);
+int ems_delete(unsigned int event_id) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
   }
-  cleanup(fd);
+
+  if (get_event_with_delay(event_id) == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  pthread_rwlock_rdlock(&checkpoint_lock);
+  pthread_mutex_lock(&directory_mutex);
+  struct Event* event = remove_from_list(event_list, event_id);
+  if (event == NULL) {
+    pthread_mutex_unlock(&directory_mutex);
+    pthread_rwlock_unlock(&checkpoint_lock);
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+  uint32_t fields[1] = {event_id};
+  uint64_t lsn = wal_append(WAL_DELETE, fields, 1);
+
+  // Operations that found the event before it was removed either finished before this or see it deleted.
+  pthread_mutex_lock(&event->lock);
+  event->deleted = 1;
+  pthread_mutex_unlock(&event->lock);
+
+  pthread_mutex_lock(&list_output_mutex);
+  list_output.len = 0;
+  pthread_rwlock_rdlock(&event_list->lock);
+  for (struct ListNode* node = event_list->head; node != NULL; node = node->next) {
+    if (buffer_append(&list_output, "Event: ", 7) != 0 || buffer_append_uint(&list_output, node->event->id) != 0 ||
+        buffer_append(&list_output, "\n", 1) != 0) {
+      fprintf(stderr, "Error updating event listing\n");
+      break;
+    }
+  }
+  pthread_rwlock_unlock(&event_list->lock);
+  pthread_mutex_unlock(&list_output_mutex);
+
+  pthread_mutex_unlock(&directory_mutex);
+  pthread_rwlock_unlock(&checkpoint_lock);
+
+  epoch_retire(event, retire_event);
+  wait_durable(lsn);
+  maybe_checkpoint();
   return 0;
 }
 
-int ems_list_events(int fd) {
-    if (event_list == NULL) {
-        char msg[] = "EMS state must be initialized\n";
-        write(fd, msg, sizeof(msg) - 1);  // sizeof(msg) - 1 to exclude the null terminator
-        cleanup(fd);
-        return 1;
+/// Encodes a range of rows of an event as runs of a seat map, see seatmap.h.
+/// @note The event's lock must be held.
+/// @return 0 if the rows were encoded successfully, 1 otherwise.
+static int encode_rows(struct Event* event, size_t first_row, size_t end_row, struct Buffer* output) {
+  struct SeatmapRun run;
+  seatmap_run_init(&run);
+  int result = 0;
+  for (size_t i = first_row; i < end_row && result == 0; i++) {
+    for (size_t j = 1; j <= event->cols && result == 0; j++) {
+      result = seatmap_add(&run, get_seat_with_delay(event, seat_index(event, i, j)), output);
     }
+  }
+  return result || seatmap_flush(&run, output) != 0;
+}
+
+/// Renders a range of rows of an event, as printed by ems_show.
+/// @note The event's lock must be held.
+/// @param event Event to render.
+/// @param binary Whether to encode the rows as in ems_render_show_bin instead.
+/// @param first_row First row to render.
+/// @param end_row Row after the last one to render.
+/// @param output Buffer to append the output to.
+/// @return 0 if the rows were rendered successfully, 1 otherwise.
+static int render_rows(struct Event* event, int binary, size_t first_row, size_t end_row, struct Buffer* output) {
+  if (binary) return encode_rows(event, first_row, end_row, output);
 
-    if (event_list->head == NULL) {
-        char msg[] = "No events\n";
-        write(fd, msg, sizeof(msg) - 1);  // sizeof(msg) - 1 to exclude the null terminator
-        cleanup(fd);
-        return 0;
+  int result = 0;
+  for (size_t i = first_row; i < end_row && result == 0; i++) {
+    for (size_t j = 1; j <= event->cols && result == 0; j++) {
+      unsigned int seat = get_seat_with_delay(event, seat_index(event, i, j));
+      result = buffer_append_uint(output, seat) != 0 || (j < event->cols && buffer_append(output, " ", 1) != 0);
     }
 
-    struct ListNode* current = event_list->head;
-    while (current != NULL) {
-        char buffer[20];  // Adjust the buffer size accordingly
-        int len = snprintf(buffer, sizeof(buffer), "Event: %u\n", (current->event)->id);
+    result = result || buffer_append(output, "\n", 1) != 0;
+  }
+  return result;
+}
+
+// Rendering of an event split into slices of rows, each rendered by a task of the pool.
+struct ShowSlices {
+  struct Event* event;
+  int binary;  // Whether the rows are encoded as in ems_render_show_bin
+  size_t num_slices;
+  struct Buffer* outputs;  // Output of each slice
+  int* results;            // Result of each slice
+};
 
-        // Write the string to the file
-        write(fd, buffer, (size_t)len);
+static void render_slice(size_t index, void* arg) {
+  struct ShowSlices* slices = arg;
+  size_t rows = slices->event->rows;
+  size_t first_row = 1 + index * rows / slices->num_slices;
+  size_t end_row = 1 + (index + 1) * rows / slices->num_slices;
+  slices->results[index] = render_rows(slices->event, slices->binary, first_row, end_row, &slices->outputs[index]);
+}
+
+/// Renders an event split into slices of rows, rendered in parallel and concatenated in order.
+/// @note The event's lock must be held. Helpers only read the seats, on behalf of the caller.
+/// Runs of a slice end with it, so a binary rendering may split a run in two at slice boundaries.
+/// @param event Event to render.
+/// @param binary Whether to encode the rows as in ems_render_show_bin.
+/// @param num_slices Number of slices, at most the number of rows.
+/// @param output Buffer to append the output to.
+/// @return 0 if the event was rendered successfully, 1 otherwise.
+static int render_slices(struct Event* event, int binary, size_t num_slices, struct Buffer* output) {
+  struct ShowSlices slices = {event, binary, num_slices, mem_malloc(MEM_COMMANDS, num_slices * sizeof(struct Buffer)),
+                              mem_malloc(MEM_COMMANDS, num_slices * sizeof(int))};
+  if (slices.outputs == NULL || slices.results == NULL) {
+    mem_free(slices.outputs);
+    mem_free(slices.results);
+    return render_rows(event, binary, 1, event->rows + 1, output);
+  }
 
-        current = current->next;
+  for (size_t i = 0; i < num_slices; i++) {
+    buffer_init(&slices.outputs[i]);
+  }
+  pool_run(num_slices, render_slice, &slices);
+
+  // Like the sequential rendering, whatever was rendered before the first failure is kept.
+  int result = 0;
+  for (size_t i = 0; i < num_slices; i++) {
+    if (result == 0) {
+      result = buffer_append(output, slices.outputs[i].data, slices.outputs[i].len) != 0 || slices.results[i] != 0;
     }
-    cleanup(fd);
-    return 0;
+    buffer_free(&slices.outputs[i]);
+  }
+  mem_free(slices.outputs);
+  mem_free(slices.results);
+  return result;
+}
+
+/// Renders an event, as text or as a seat map.
+/// @return 0 if the event was rendered successfully, 1 otherwise.
+static int render_event(unsigned int event_id, int binary, struct Buffer* output) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Keeps the event from being freed by a concurrent DELETE while it is used.
+  epoch_enter();
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    epoch_exit();
+    return 1;
+  }
+
+  if (lock_event(event) != 0) {
+    epoch_exit();
+    return 1;
+  }
+  int result;
+  size_t num_slices = event->rows;
+  if (num_slices > (pool_size() + 1) * SHOW_SLICES_PER_THREAD) {
+    num_slices = (pool_size() + 1) * SHOW_SLICES_PER_THREAD;
+  }
+  if (binary && seatmap_begin(output, event->rows, event->cols) != 0) {
+    result = 1;
+  } else if (pool_size() == 0 || event->rows * event->cols < PARALLEL_SHOW_THRESHOLD || num_slices < 2) {
+    result = render_rows(event, binary, 1, event->rows + 1, output);
+  } else {
+    result = render_slices(event, binary, num_slices, output);
+  }
+  pthread_mutex_unlock(&event->lock);
+  epoch_exit();
+
+  if (result != 0) {
+    fprintf(stderr, "Error allocating memory for event output\n");
+  }
+  return result;
+}
+
+int ems_render_show(unsigned int event_id, struct Buffer* output) { return render_event(event_id, 0, output); }
+
+int ems_render_show_bin(unsigned int event_id, struct Buffer* output) { return render_event(event_id, 1, output); }
+
+int ems_show(unsigned int event_id, int fd) {
+  struct Buffer output;
+  buffer_init(&output);
+  int result = ems_render_show(event_id, &output);
+  // Whatever was rendered is written, as if the seats had been written one by one.
+  if (write_all(fd, output.data, output.len) != 0) {
+    result = 1;
+  }
+  buffer_free(&output);
+  cleanup(fd);
+  return result;
+}
+
+int ems_render_list_events(struct Buffer* output) {
+  if (event_list == NULL) {
+    char msg[] = "EMS state must be initialized\n";
+    buffer_append(output, msg, sizeof(msg) - 1);  // sizeof(msg) - 1 to exclude the null terminator
+    return 1;
+  }
+
+  pthread_mutex_lock(&list_output_mutex);
+  int result;
+  if (list_output.len == 0) {
+    char msg[] = "No events\n";
+    result = buffer_append(output, msg, sizeof(msg) - 1);  // sizeof(msg) - 1 to exclude the null terminator
+  } else {
+    result = buffer_append(output, list_output.data, list_output.len);
+  }
+  pthread_mutex_unlock(&list_output_mutex);
+
+  return result;
+}
+
+int ems_list_events(int fd) {
+  struct Buffer output;
+  buffer_init(&output);
+  int result = ems_render_list_events(&output);
+  if (write_all(fd, output.data, output.len) != 0) {
+    result = 1;
+  }
+  buffer_free(&output);
+  return result;
 }
 
+int ems_render_mem_stats(struct Buffer* output) { return mem_render(output); }
 
 void ems_wait(unsigned int delay_ms) {
   struct timespec delay = delay_to_timespec(delay_ms);
@@ -3,12 +3,18 @@
 
 #include <stddef.h>
 
+#include "buffer.h"
+
 /// Initializes the EMS state.
 /// @param delay_ms State access delay in milliseconds.
+/// @param wal_path Path of the write-ahead log to recover from and append to, NULL to keep the state in memory only.
+/// @param flush_interval_ms Time the log waits to group more operations into each sync.
+/// @param show_threads Number of helper threads rendering slices of large events, 0 to render every event
+/// on the thread that shows it.
 /// @return 0 if the EMS state was initialized successfully, 1 otherwise.
-int ems_init(unsigned int delay_ms);
+int ems_init(unsigned int delay_ms, const char *wal_path, unsigned int flush_interval_ms, unsigned int show_threads);
 
-/// Destroys the EMS state.
+/// Destroys the EMS state, flushing the write-ahead log if there is one.
 int ems_terminate();
 
 /// Creates a new event with the given id and dimensions.
@@ -26,15 +32,92 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
 
+/// Creates reservations for the given event one after the other, looking the event up only once. Each
+/// reservation succeeds or fails on its own, as if it was made by ems_reserve.
+/// @param event_id Id of the event to create the reservations for.
+/// @param num_requests Number of reservations.
+/// @param num_seats Array with the number of seats of each reservation.
+/// @param xs Array of rows of the seats to reserve, one reservation after the other.
+/// @param ys Array of columns of the seats to reserve, one reservation after the other.
+/// @param results Array to store whether each reservation failed (1) or was created (0) in.
+/// @return 0 if the event was found, 1 otherwise (and every reservation failed).
+int ems_reserve_batch(unsigned int event_id, size_t num_requests, size_t *num_seats, size_t *xs, size_t *ys,
+                      int *results);
+
+/// Creates one reservation in each of the given events, atomically: either every reservation is
+/// created or none is.
+/// @param num_events Number of events.
+/// @param event_ids Array of ids of the events, which must be distinct.
+/// @param num_seats Array with the number of seats to reserve in each event.
+/// @param xs Array of rows of the seats to reserve, event after event.
+/// @param ys Array of columns of the seats to reserve, event after event.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+int ems_reserve_multi(size_t num_events, unsigned int* event_ids, size_t* num_seats, size_t* xs, size_t* ys);
+
+/// Reserves the best available seats of an event: the first free seats in row-major order,
+/// or the first run of adjacent free seats in the frontmost row that has one.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of seats to reserve.
+/// @param contiguous Whether the seats must be adjacent in a single row.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, int contiguous);
+
+/// Prints the seats of a reservation, in the same order they were reserved.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id of the reservation to print.
+/// @param fd File descriptor to print to.
+/// @return 0 if the reservation was printed successfully, 1 otherwise.
+int ems_query(unsigned int event_id, unsigned int reservation_id, int fd);
+
+/// Renders the seats of a reservation into a buffer, as printed by ems_query.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id of the reservation to render.
+/// @param output Buffer to append the output to.
+/// @return 0 if the reservation was rendered successfully, 1 otherwise.
+int ems_render_query(unsigned int event_id, unsigned int reservation_id, struct Buffer *output);
+
+/// Cancels a reservation, freeing its seats. Reservation ids are not reused.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id of the reservation to cancel.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Deletes an event and its reservations. Its memory is freed once no operation can still be using it.
+/// @param event_id Id of the event to delete.
+/// @return 0 if the event was deleted successfully, 1 otherwise.
+int ems_delete(unsigned int event_id);
+
 /// Prints the given event.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
 int ems_show(unsigned int event_id, int fd);
 
+/// Renders the given event into a buffer, as printed by ems_show.
+/// @param event_id Id of the event to render.
+/// @param output Buffer to append the output to.
+/// @return 0 if the event was rendered successfully, 1 otherwise.
+int ems_render_show(unsigned int event_id, struct Buffer *output);
+
+/// Encodes the given event into a buffer as a seat map, a compact binary form of what ems_show prints.
+/// @param event_id Id of the event to encode.
+/// @param output Buffer to append the seat map to, see seatmap.h for its layout.
+/// @return 0 if the event was encoded successfully, 1 otherwise.
+int ems_render_show_bin(unsigned int event_id, struct Buffer *output);
+
 /// Prints all the events.
 /// @return 0 if the events were printed successfully, 1 otherwise.
 int ems_list_events(int fd);
 
+/// Renders all the events into a buffer, as printed by ems_list_events.
+/// @param output Buffer to append the output to.
+/// @return 0 if the events were rendered successfully, 1 otherwise.
+int ems_render_list_events(struct Buffer *output);
+
+/// Renders how much memory the state uses, by category, with the peak of each.
+/// @param output Buffer to append the output to.
+/// @return 0 if the statistics were rendered successfully, 1 otherwise.
+int ems_render_mem_stats(struct Buffer *output);
+
 /// Waits for a given amount of time.
 /// @param delay_us Delay in milliseconds.
 void ems_wait(unsigned int delay_ms);
@@ -0,0 +1,97 @@
+#define _GNU_SOURCE  // vmsplice, splice and F_SETPIPE_SZ
+#include "output.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "constants.h"
+
+/// Stops splicing, so that everything else is written.
+static void stop_splicing(struct Output* output) {
+  if (output->pipe_fds[0] >= 0) {
+    close(output->pipe_fds[0]);
+    close(output->pipe_fds[1]);
+  }
+  output->pipe_fds[0] = output->pipe_fds[1] = -1;
+}
+
+void output_init(struct Output* output, int fd, int zero_copy) {
+  output->fd = fd;
+  output->pipe_fds[0] = output->pipe_fds[1] = -1;
+  output->pipe_size = 0;
+  output->spliced = 0;
+  output->written = 0;
+  if (!zero_copy) return;
+
+  if (pipe(output->pipe_fds) != 0) {
+    perror("Error creating output pipe");
+    output->pipe_fds[0] = output->pipe_fds[1] = -1;
+    return;
+  }
+  // A larger pipe takes more pages per round trip; the default size is kept if it cannot be raised.
+  fcntl(output->pipe_fds[1], F_SETPIPE_SZ, OUTPUT_PIPE_SIZE);
+  int size = fcntl(output->pipe_fds[1], F_GETPIPE_SZ);
+  if (size <= 0) {
+    stop_splicing(output);
+    return;
+  }
+  output->pipe_size = (size_t)size;
+}
+
+/// Writes whatever is left in the pipe after splice failed.
+/// @return 0 if the pipe was drained into the file, 1 otherwise.
+static int drain_pipe(struct Output* output, size_t len) {
+  char chunk[4096];
+  while (len > 0) {
+    ssize_t bytes = read(output->pipe_fds[0], chunk, len < sizeof(chunk) ? len : sizeof(chunk));
+    if (bytes < 0 && errno == EINTR) continue;
+    if (bytes <= 0 || write_all(output->fd, chunk, (size_t)bytes) != 0) return 1;
+    output->written += (unsigned long long)bytes;
+    len -= (size_t)bytes;
+  }
+  return 0;
+}
+
+int output_write(struct Output* output, const char* data, size_t len) {
+  // Small outputs cost less to copy than to map into the pipe.
+  while (output->pipe_fds[0] >= 0 && len >= OUTPUT_SPLICE_MIN_BYTES) {
+    struct iovec iov = {(void*)data, len < output->pipe_size ? len : output->pipe_size};
+    ssize_t queued = vmsplice(output->pipe_fds[1], &iov, 1, 0);
+    if (queued < 0 && errno == EINTR) continue;
+    if (queued <= 0) {
+      stop_splicing(output);
+      break;
+    }
+
+    // The pipe is emptied before returning, so the caller can reuse the pages right after.
+    size_t left = (size_t)queued;
+    while (left > 0) {
+      ssize_t moved = splice(output->pipe_fds[0], NULL, output->fd, NULL, left, SPLICE_F_MOVE);
+      if (moved < 0 && errno == EINTR) continue;
+      if (moved <= 0) {
+        int result = drain_pipe(output, left);
+        stop_splicing(output);
+        if (result != 0) return 1;
+        break;
+      }
+      output->spliced += (unsigned long long)moved;
+      left -= (size_t)moved;
+    }
+    data += queued;
+    len -= (size_t)queued;
+  }
+
+  if (write_all(output->fd, data, len) != 0) return 1;
+  output->written += len;
+  return 0;
+}
+
+void output_report(const struct Output* output) {
+  printf("Output: %llu bytes spliced, %llu bytes written\n", output->spliced, output->written);
+}
+
+void output_destroy(struct Output* output) { stop_splicing(output); }
@@ -0,0 +1,40 @@
+#ifndef EMS_OUTPUT_H
+#define EMS_OUTPUT_H
+
+#include <stddef.h>
+
+// Where the outputs of a job file go. Large outputs can be moved to the file through a pipe: vmsplice maps
+// the pages of the buffer into the pipe instead of copying them, and splice moves them on to the file.
+// Everything else, and everything once splicing fails, is written with write.
+struct Output {
+  int fd;                      // File descriptor the outputs are written to
+  int pipe_fds[2];             // Pipe the pages are spliced through, -1 if splicing is off
+  size_t pipe_size;            // Capacity of the pipe in bytes
+  unsigned long long spliced;  // Bytes moved with vmsplice and splice
+  unsigned long long written;  // Bytes moved with write
+};
+
+/// Initializes an output.
+/// @param output Output to be initialized.
+/// @param fd File descriptor to write the outputs to.
+/// @param zero_copy Whether to splice large outputs. Splicing is left off if the pipe cannot be created.
+void output_init(struct Output* output, int fd, int zero_copy);
+
+/// Writes the whole contents of a byte range.
+/// @note Only one thread may write to an output at a time. The bytes may be read by the kernel until this
+/// returns, and must not be modified before.
+/// @param output Output to write to.
+/// @param data Bytes to write.
+/// @param len Number of bytes to write.
+/// @return 0 if everything was written, 1 otherwise.
+int output_write(struct Output* output, const char* data, size_t len);
+
+/// Prints how many bytes took each path.
+/// @param output Output to report on.
+void output_report(const struct Output* output);
+
+/// Closes the pipe of an output. The file descriptor written to is left open.
+/// @param output Output to be destroyed.
+void output_destroy(struct Output* output);
+
+#endif  // EMS_OUTPUT_H
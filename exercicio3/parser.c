@@ -8,16 +8,13 @@
 
 #include "constants.h"
 
-static int read_uint(int fd, unsigned int *value, char *next) {
+/// Same as read_uint, with the first character of the number already read.
+static int read_uint_after(int fd, char first, unsigned int *value, char *next) {
   char buf[16];
 
+  buf[0] = first;
   int i = 0;
   while (1) {
-    if (read(fd, buf + i, 1) == 0) {
-      *next = '\0';
-      break;
-    }
-
     *next = buf[i];
 
     if (buf[i] > '9' || buf[i] < '0') {
@@ -25,7 +22,15 @@ static int read_uint(int fd, unsigned int *value, char *next) {
       break;
     }
 
-    i++;
+    if (++i == sizeof(buf)) {
+      return 1;
+    }
+
+    if (read(fd, buf + i, 1) != 1) {
+      *next = '\0';
+      buf[i] = '\0';
+      break;
+    }
   }
 
   unsigned long ul = strtoul(buf, NULL, 10);
@@ -39,12 +44,32 @@ static int read_uint(int fd, unsigned int *value, char *next) {
   return 0;
 }
 
+static int read_uint(int fd, unsigned int *value, char *next) {
+  char first;
+  if (read(fd, &first, 1) != 1) {
+    first = '\0';
+  }
+
+  return read_uint_after(fd, first, value, next);
+}
+
 static void cleanup(int fd) {
   char ch;
   while (read(fd, &ch, 1) == 1 && ch != '\n')
     ;
 }
 
+/// Reads a fixed number of characters, stopping early at the end of the line so that the next command is
+/// never read.
+/// @return Number of characters read, the newline included.
+static size_t read_chars(int fd, char *buf, size_t len) {
+  size_t n = 0;
+  while (n < len && read(fd, buf + n, 1) == 1) {
+    if (buf[n++] == '\n') break;
+  }
+  return n;
+}
+
 enum Command get_next(int fd) {
   char buf[16];
   if (read(fd, buf, 1) != 1) {
@@ -52,28 +77,85 @@ enum Command get_next(int fd) {
   }
   switch (buf[0]) {
     case 'C':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "CREATE ", 7) != 0) {
+      if (read(fd, buf + 1, 6) != 6) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      return CMD_CREATE;
+      if (strncmp(buf, "CREATE ", 7) == 0) {
+        return CMD_CREATE;
+      }
+
+      if (strncmp(buf, "CANCEL ", 7) == 0) {
+        return CMD_CANCEL;
+      }
+
+      cleanup(fd);
+      return CMD_INVALID;
+
+    case 'Q':
+      if (read(fd, buf + 1, 5) != 5 || strncmp(buf, "QUERY ", 6) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_QUERY;
 
     case 'R':
-      if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE ", 8) != 0) {
+      if (read(fd, buf + 1, 7) != 7) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "RESERVE ", 8) == 0) {
+        return CMD_RESERVE;
+      }
+
+      if (strncmp(buf, "RESERVE_", 8) != 0 || read(fd, buf + 8, 5) != 5) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      return CMD_RESERVE;
+      if (strncmp(buf + 8, "BEST ", 5) == 0) {
+        return CMD_RESERVE_BEST;
+      }
+
+      if (strncmp(buf + 8, "MULTI", 5) != 0 || read(fd, buf + 13, 1) != 1 || buf[13] != ' ') {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_RESERVE_MULTI;
+
+    case 'D':
+      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "DELETE ", 7) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_DELETE;
 
     case 'S':
-      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
+      if (read(fd, buf + 1, 4) != 4) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "SHOW ", 5) == 0) {
+        return CMD_SHOW;
+      }
+
+      if (strncmp(buf, "STATS", 5) != 0 || read(fd, buf + 5, 4) != 4 || strncmp(buf + 5, " MEM", 4) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (read(fd, buf + 9, 1) != 0 && buf[9] != '\n') {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      return CMD_SHOW;
+      return CMD_STATS;
 
     case 'L':
       if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
@@ -160,14 +242,11 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
   return 0;
 }
 
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+/// Reads a list of coordinates of the form [(<x1>,<y1>) (<x2>,<y2>) ...].
+/// @return Number of coordinates read. 0 on failure, in which case the rest of the line was consumed.
+static size_t read_coords(int fd, size_t max, size_t *xs, size_t *ys) {
   char ch;
 
-  if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
-    cleanup(fd);
-    return 0;
-  }
-
   if (read(fd, &ch, 1) != 1 || ch != '[') {
     cleanup(fd);
     return 0;
@@ -206,11 +285,28 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
     }
   }
 
-  if (num_coords == max) {
+  // max coordinates are allowed, but not one more.
+  if (ch != ']') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return num_coords;
+}
+
+size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
     cleanup(fd);
     return 0;
   }
 
+  size_t num_coords = read_coords(fd, max, xs, ys);
+  if (num_coords == 0) {
+    return 0;
+  }
+
   if (read(fd, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
     cleanup(fd);
     return 0;
@@ -219,6 +315,88 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
   return num_coords;
 }
 
+size_t parse_reserve_multi(int fd, size_t max_events, size_t max, unsigned int *event_ids, size_t *num_seats,
+                           size_t *xs, size_t *ys) {
+  size_t num_events = 0;
+  size_t total = 0;
+  char ch = ' ';
+
+  while (ch == ' ') {
+    if (num_events == max_events) {
+      cleanup(fd);
+      return 0;
+    }
+
+    if (read_uint(fd, &event_ids[num_events], &ch) != 0 || ch != ' ') {
+      cleanup(fd);
+      return 0;
+    }
+
+    size_t num_coords = read_coords(fd, max - total, xs + total, ys + total);
+    if (num_coords == 0) {
+      return 0;
+    }
+    num_seats[num_events++] = num_coords;
+    total += num_coords;
+
+    if (read(fd, &ch, 1) != 1) {
+      ch = '\0';
+    }
+  }
+
+  if (ch != '\n' && ch != '\0') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return num_events;
+}
+
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats, int *contiguous) {
+  char ch;
+
+  if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    if (ch != '\n') {
+      cleanup(fd);
+    }
+    return 1;
+  }
+
+  unsigned int u_num_seats;
+  if (read_uint(fd, &u_num_seats, &ch) != 0 || u_num_seats == 0 || u_num_seats > MAX_RESERVATION_SIZE) {
+    if (ch != '\n') {
+      cleanup(fd);
+    }
+    return 1;
+  }
+  *num_seats = (size_t)u_num_seats;
+  *contiguous = 0;
+
+  if (ch == ' ') {
+    char word[10];
+    size_t n = read_chars(fd, word, sizeof(word));
+    if (n != sizeof(word) || strncmp(word, "contiguous", sizeof(word)) != 0) {
+      // The end of the line may have been read already.
+      if (n == 0 || word[n - 1] != '\n') {
+        cleanup(fd);
+      }
+      return 1;
+    }
+    *contiguous = 1;
+
+    if (read(fd, &ch, 1) != 1) {
+      ch = '\0';
+    }
+  }
+
+  if (ch != '\n' && ch != '\0') {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
 int parse_show(int fd, unsigned int *event_id) {
   char ch;
 
@@ -230,6 +408,62 @@ int parse_show(int fd, unsigned int *event_id) {
   return 0;
 }
 
+int parse_show_format(int fd, unsigned int *event_id, int *binary) {
+  char buf[4];
+
+  if (read(fd, buf, 1) != 1) {
+    buf[0] = '\0';
+  }
+
+  *binary = buf[0] == 'B';
+  if (!*binary) {
+    char ch;
+    if (read_uint_after(fd, buf[0], event_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+      if (ch != '\n') {
+        cleanup(fd);
+      }
+      return 1;
+    }
+
+    return 0;
+  }
+
+  size_t n = read_chars(fd, buf + 1, 3);
+  if (n != 3 || strncmp(buf, "BIN ", 4) != 0) {
+    // The end of the line may have been read already.
+    if (buf[n] != '\n') {
+      cleanup(fd);
+    }
+    return 1;
+  }
+
+  return parse_show(fd, event_id);
+}
+
+static int parse_reservation_ref(int fd, unsigned int *event_id, unsigned int *reservation_id) {
+  char ch;
+
+  if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  if (read_uint(fd, reservation_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
+int parse_query(int fd, unsigned int *event_id, unsigned int *reservation_id) {
+  return parse_reservation_ref(fd, event_id, reservation_id);
+}
+
+int parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id) {
+  return parse_reservation_ref(fd, event_id, reservation_id);
+}
+
 int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
     char ch;
 
@@ -258,3 +492,52 @@ int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
 
   return 1;  // Indicates thread_id was provided
 }
+
+int parse_command(int fd, struct ParsedCommand *command) {
+  command->type = get_next(fd);
+
+  switch (command->type) {
+    case CMD_CREATE:
+      return parse_create(fd, &command->event_id, &command->num_rows, &command->num_cols);
+
+    case CMD_RESERVE:
+      command->num_seats = parse_reserve(fd, MAX_RESERVATION_SIZE, &command->event_id, command->xs, command->ys);
+      return command->num_seats == 0;
+
+    case CMD_RESERVE_MULTI:
+      command->num_events = parse_reserve_multi(fd, MAX_MULTI_EVENTS, MAX_RESERVATION_SIZE, command->event_ids,
+                                                command->multi_seats, command->xs, command->ys);
+      return command->num_events == 0;
+
+    case CMD_RESERVE_BEST:
+      return parse_reserve_best(fd, &command->event_id, &command->num_seats, &command->contiguous);
+
+    case CMD_SHOW:
+      return parse_show_format(fd, &command->event_id, &command->binary);
+
+    case CMD_QUERY:
+      return parse_query(fd, &command->event_id, &command->reservation_id);
+
+    case CMD_CANCEL:
+      return parse_cancel(fd, &command->event_id, &command->reservation_id);
+
+    // DELETE takes the same arguments as SHOW
+    case CMD_DELETE:
+      return parse_show(fd, &command->event_id);
+
+    case CMD_WAIT:
+      command->thread_id = 0;
+      return parse_wait(fd, &command->delay, &command->thread_id) == -1;
+
+    case CMD_LIST_EVENTS:
+    case CMD_STATS:
+    case CMD_BARRIER:
+    case CMD_HELP:
+    case CMD_EMPTY:
+    case CMD_INVALID:
+    case EOC:
+      return 0;
+  }
+
+  return 0;
+}
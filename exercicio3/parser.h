@@ -3,11 +3,19 @@
 
 #include <stddef.h>
 
+#include "constants.h"
+
 enum Command {
   CMD_CREATE,
   CMD_RESERVE,
+  CMD_RESERVE_BEST,
+  CMD_RESERVE_MULTI,
   CMD_SHOW,
+  CMD_QUERY,
+  CMD_CANCEL,
+  CMD_DELETE,
   CMD_LIST_EVENTS,
+  CMD_STATS,  // STATS MEM
   CMD_BARRIER,
   CMD_WAIT,
   CMD_HELP,
@@ -16,6 +24,24 @@ enum Command {
   EOC  // End of commands
 };
 
+// A command read from a job file, with its arguments. Only the fields used by its type are set.
+struct ParsedCommand {
+  enum Command type;
+
+  unsigned int event_id;        // CREATE, RESERVE, RESERVE_BEST, SHOW, QUERY, CANCEL, DELETE
+  int binary;                   // SHOW: whether the seats are encoded as a seat map (SHOW BIN)
+  unsigned int reservation_id;  // QUERY, CANCEL
+  size_t num_rows, num_cols;    // CREATE
+  size_t num_seats;             // RESERVE, RESERVE_BEST
+  int contiguous;               // RESERVE_BEST
+  size_t num_events;            // RESERVE_MULTI
+  unsigned int event_ids[MAX_MULTI_EVENTS];  // RESERVE_MULTI
+  size_t multi_seats[MAX_MULTI_EVENTS];      // RESERVE_MULTI: number of seats of each event
+  size_t xs[MAX_RESERVATION_SIZE];           // RESERVE, RESERVE_MULTI
+  size_t ys[MAX_RESERVATION_SIZE];           // RESERVE, RESERVE_MULTI
+  unsigned int delay;                        // WAIT
+  unsigned int thread_id;                    // WAIT, 0 if every thread waits
+};
 
 
 /// Reads a line and returns the corresponding command.
@@ -23,6 +49,12 @@ enum Command {
 /// @return The command read.
 enum Command get_next(int fd);
 
+/// Reads a line and parses the command in it, with its arguments.
+/// @param fd File descriptor to read from.
+/// @param command Command to be filled. Its type is set even if the arguments are invalid.
+/// @return 0 if the command was parsed successfully, 1 if its arguments are invalid.
+int parse_command(int fd, struct ParsedCommand *command);
+
 /// Parses a CREATE command.
 /// @param fd File descriptor to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
@@ -40,12 +72,53 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
 /// @return Number of coordinates read. 0 on failure.
 size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
 
+/// Parses a RESERVE_MULTI command, made of one event ID and coordinate list per event.
+/// @param fd File descriptor to read from.
+/// @param max_events Maximum number of events to read.
+/// @param max Maximum number of coordinates to read, across all events.
+/// @param event_ids Pointer to the array to store the event IDs in.
+/// @param num_seats Pointer to the array to store the number of coordinates of each event in.
+/// @param xs Pointer to the array to store the X coordinates in, event after event.
+/// @param ys Pointer to the array to store the Y coordinates in, event after event.
+/// @return Number of events read. 0 on failure.
+size_t parse_reserve_multi(int fd, size_t max_events, size_t max, unsigned int *event_ids, size_t *num_seats,
+                           size_t *xs, size_t *ys);
+
+/// Parses a RESERVE_BEST command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param num_seats Pointer to the variable to store the number of seats in.
+/// @param contiguous Pointer to the variable to store whether the seats must be adjacent in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats, int *contiguous);
+
 /// Parses a SHOW command.
 /// @param fd File descriptor to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_show(int fd, unsigned int *event_id);
 
+/// Parses a SHOW command that may ask for a seat map, as in "SHOW BIN <event_id>".
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param binary Pointer to the variable to store whether BIN was given in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_show_format(int fd, unsigned int *event_id, int *binary);
+
+/// Parses a QUERY command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param reservation_id Pointer to the variable to store the reservation ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_query(int fd, unsigned int *event_id, unsigned int *reservation_id);
+
+/// Parses a CANCEL command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param reservation_id Pointer to the variable to store the reservation ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id);
+
 /// Parses a WAIT command.
 /// @param fd File descriptor to read from.
 /// @param delay Pointer to the variable to store the wait delay in.
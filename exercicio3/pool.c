@@ -0,0 +1,140 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Job submitted by pool_run, which lives on the stack of the submitting thread.
+struct Job {
+  pool_task_fn task;
+  void* arg;
+  size_t num_tasks;
+  size_t next_task;       // Index of the next task to be taken
+  size_t running;         // Number of tasks taken and not yet completed
+  pthread_cond_t done;    // Signalled when the last task completes
+  struct Job* next;
+};
+
+static pthread_t* threads = NULL;
+static unsigned int num_threads = 0;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;  // Signalled when jobs are submitted
+static struct Job* jobs = NULL;    // Jobs with tasks still to be taken, oldest first
+static int stopping = 0;
+
+/// Takes the next task of a job, dropping the job from the queue once its last task is taken.
+/// @note Must be called with pool_mutex held and with tasks still to be taken.
+/// @return Index of the task taken.
+static size_t take_task(struct Job* job) {
+  size_t index = job->next_task++;
+  job->running++;
+  if (job->next_task == job->num_tasks) {
+    struct Job** link = &jobs;
+    while (*link != job) {
+      link = &(*link)->next;
+    }
+    *link = job->next;
+  }
+  return index;
+}
+
+/// Runs a task taken from a job, then marks it completed.
+/// @note Must be called with pool_mutex held, which is released while the task runs.
+static void run_task(struct Job* job, size_t index) {
+  pthread_mutex_unlock(&pool_mutex);
+  job->task(index, job->arg);
+  pthread_mutex_lock(&pool_mutex);
+
+  if (--job->running == 0 && job->next_task == job->num_tasks) {
+    pthread_cond_signal(&job->done);
+  }
+}
+
+static void* helper_loop(void* arg) {
+  (void)arg;
+  pthread_mutex_lock(&pool_mutex);
+  while (1) {
+    while (jobs == NULL && !stopping) {
+      pthread_cond_wait(&work_cond, &pool_mutex);
+    }
+    if (jobs == NULL) break;
+
+    struct Job* job = jobs;
+    run_task(job, take_task(job));
+  }
+  pthread_mutex_unlock(&pool_mutex);
+  return NULL;
+}
+
+int pool_start(unsigned int count) {
+  if (count == 0) return 0;
+
+  threads = malloc(count * sizeof(pthread_t));
+  if (threads == NULL) {
+    fprintf(stderr, "Error allocating memory for helper threads\n");
+    return 1;
+  }
+
+  stopping = 0;
+  for (num_threads = 0; num_threads < count; num_threads++) {
+    if (pthread_create(&threads[num_threads], NULL, helper_loop, NULL) != 0) {
+      perror("Error creating helper thread");
+      pool_stop();
+      return 1;
+    }
+  }
+  return 0;
+}
+
+unsigned int pool_size() { return num_threads; }
+
+void pool_run(size_t num_tasks, pool_task_fn task, void* arg) {
+  if (num_threads == 0 || num_tasks <= 1) {
+    for (size_t i = 0; i < num_tasks; i++) {
+      task(i, arg);
+    }
+    return;
+  }
+
+  struct Job job;
+  job.task = task;
+  job.arg = arg;
+  job.num_tasks = num_tasks;
+  job.next_task = 0;
+  job.running = 0;
+  job.next = NULL;
+  pthread_cond_init(&job.done, NULL);
+
+  pthread_mutex_lock(&pool_mutex);
+  struct Job** link = &jobs;
+  while (*link != NULL) {
+    link = &(*link)->next;
+  }
+  *link = &job;
+  pthread_cond_broadcast(&work_cond);
+
+  // The caller never waits while its job has tasks left, so it makes progress even if every helper is busy.
+  while (job.next_task < job.num_tasks) {
+    run_task(&job, take_task(&job));
+  }
+  while (job.running > 0) {
+    pthread_cond_wait(&job.done, &pool_mutex);
+  }
+  pthread_mutex_unlock(&pool_mutex);
+
+  pthread_cond_destroy(&job.done);
+}
+
+void pool_stop() {
+  pthread_mutex_lock(&pool_mutex);
+  stopping = 1;
+  pthread_cond_broadcast(&work_cond);
+  pthread_mutex_unlock(&pool_mutex);
+
+  for (unsigned int i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  threads = NULL;
+  num_threads = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef EMS_POOL_H
+#define EMS_POOL_H
+
+#include <stddef.h>
+
+/// Function running one task of a job.
+/// @param index Index of the task, from 0 to the number of tasks of the job.
+/// @param arg Argument given to pool_run.
+typedef void (*pool_task_fn)(size_t index, void* arg);
+
+/// Starts the helper threads. Without them, every job runs on the thread that submits it.
+/// @param num_threads Number of helper threads, 0 to start none.
+/// @return 0 if the threads were started successfully, 1 otherwise.
+int pool_start(unsigned int num_threads);
+
+/// Number of helper threads started.
+unsigned int pool_size();
+
+/// Runs the tasks of a job on the calling thread and on any idle helper thread, returning once every task
+/// has completed. Tasks of the same job may run at the same time.
+/// @param num_tasks Number of tasks of the job.
+/// @param task Function running each task.
+/// @param arg Argument passed to every task.
+void pool_run(size_t num_tasks, pool_task_fn task, void* arg);
+
+/// Stops the helper threads. No job may be running.
+void pool_stop();
+
+#endif  // EMS_POOL_H
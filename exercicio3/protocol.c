@@ -0,0 +1,26 @@
+#include "protocol.h"
+
+size_t protocol_encode_reservation(uint32_t* fields, unsigned int event_id, size_t num_seats, const size_t* xs,
+                                   const size_t* ys) {
+  size_t n = 0;
+  fields[n++] = event_id;
+  fields[n++] = (uint32_t)num_seats;
+  for (size_t i = 0; i < num_seats; i++) {
+    fields[n++] = (uint32_t)xs[i];
+    fields[n++] = (uint32_t)ys[i];
+  }
+  return n;
+}
+
+size_t protocol_decode_reservation(const uint32_t* fields, size_t num_fields, size_t* xs, size_t* ys,
+                                   size_t max_seats) {
+  if (num_fields < 2 || fields[1] == 0 || fields[1] > max_seats || (num_fields - 2) / 2 < fields[1]) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < fields[1]; i++) {
+    xs[i] = fields[2 + 2 * i];
+    ys[i] = fields[3 + 2 * i];
+  }
+  return 2 + 2 * (size_t)fields[1];
+}
@@ -0,0 +1,72 @@
+#ifndef EMS_PROTOCOL_H
+#define EMS_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+
+#define MAX_PIPE_PATH_LEN 256
+
+// Most fields a request can carry: a RESERVE_MULTI with every event and seat allowed.
+#define MAX_REQUEST_FIELDS (1 + 2 * MAX_MULTI_EVENTS + 2 * MAX_RESERVATION_SIZE)
+
+// Message a client writes to the registration FIFO to open a session. It is smaller than
+// PIPE_BUF, so registrations of concurrent clients never interleave.
+struct Registration {
+  char request_path[MAX_PIPE_PATH_LEN];   // FIFO the client writes requests to
+  char response_path[MAX_PIPE_PATH_LEN];  // FIFO the server writes responses to
+};
+
+// Operations a client can request. Every request is a list of 32-bit fields.
+enum RequestType {
+  REQUEST_CREATE = 1,         // event_id, num_rows, num_cols
+  REQUEST_RESERVE = 2,        // event_id, num_seats, then num_seats (x, y) pairs
+  REQUEST_RESERVE_BEST = 3,   // event_id, num_seats, contiguous
+  REQUEST_RESERVE_MULTI = 4,  // num_events, then one REQUEST_RESERVE payload per event
+  REQUEST_SHOW = 5,           // event_id
+  REQUEST_QUERY = 6,          // event_id, reservation_id
+  REQUEST_CANCEL = 7,         // event_id, reservation_id
+  REQUEST_LIST = 8,           // (no fields)
+  REQUEST_STATS_MEM = 9,      // (no fields)
+  REQUEST_DELETE = 10,        // event_id
+  REQUEST_SHOW_BIN = 11,      // event_id
+};
+
+// Header of a request, followed by num_fields 32-bit fields. A client may send many requests
+// before reading any response.
+struct RequestHeader {
+  uint32_t sequence;  // Chosen by the client, echoed in the response
+  uint32_t type;
+  uint32_t num_fields;
+};
+
+// Header of a response, followed by length bytes of output. Requests of a session are executed
+// concurrently, so responses may arrive in any order.
+struct ResponseHeader {
+  uint32_t sequence;  // Sequence number of the request answered
+  int32_t status;     // 0 if the operation succeeded, 1 otherwise
+  uint32_t length;
+};
+
+/// Encodes a reservation in the REQUEST_RESERVE layout.
+/// @param fields Array to store the fields in, with room for 2 + 2 * num_seats fields.
+/// @param event_id Id of the event.
+/// @param num_seats Number of seats.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return Number of fields written.
+size_t protocol_encode_reservation(uint32_t* fields, unsigned int event_id, size_t num_seats, const size_t* xs,
+                                   const size_t* ys);
+
+/// Decodes a reservation in the REQUEST_RESERVE layout.
+/// @param fields Fields to decode, starting with the event id.
+/// @param num_fields Number of fields available.
+/// @param xs Array to store the rows of the seats in.
+/// @param ys Array to store the columns of the seats in.
+/// @param max_seats Number of seats xs and ys have room for.
+/// @return Number of fields used by the reservation, 0 if it is malformed or has more than max_seats seats.
+size_t protocol_decode_reservation(const uint32_t* fields, size_t num_fields, size_t* xs, size_t* ys,
+                                   size_t max_seats);
+
+#endif  // EMS_PROTOCOL_H
@@ -0,0 +1,113 @@
+#include "ring.h"
+
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int ring_init(struct Ring* ring, size_t capacity) {
+  size_t size = 1;
+  while (size < capacity) {
+    size *= 2;
+  }
+
+  ring->cells = malloc(size * sizeof(struct RingCell));
+  if (ring->cells == NULL) {
+    fprintf(stderr, "Error allocating memory for ring\n");
+    return 1;
+  }
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&ring->cells[i].sequence, i);
+    ring->cells[i].value = NULL;
+  }
+  ring->mask = size - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->push_stalls, 0);
+  atomic_init(&ring->pop_stalls, 0);
+  atomic_init(&ring->max_depth, 0);
+
+  if (size > SEM_VALUE_MAX || sem_init(&ring->filled, 0, 0) != 0 ||
+      sem_init(&ring->free, 0, (unsigned int)size) != 0) {
+    perror("Error initializing ring");
+    free(ring->cells);
+    return 1;
+  }
+  return 0;
+}
+
+/// Takes a token from a semaphore, counting a stall if none is available right away.
+static void acquire(sem_t* semaphore, atomic_ulong* stalls) {
+  if (sem_trywait(semaphore) == 0) return;
+
+  atomic_fetch_add_explicit(stalls, 1, memory_order_relaxed);
+  while (sem_wait(semaphore) != 0)
+    ;  // Interrupted by a signal
+}
+
+void ring_push(struct Ring* ring, void* value) {
+  acquire(&ring->free, &ring->push_stalls);
+
+  // The token guarantees a free cell, but the one at the claimed position may still be on its way out.
+  size_t position = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  struct RingCell* cell;
+  while (1) {
+    cell = &ring->cells[position & ring->mask];
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    if (sequence == position) {
+      if (atomic_compare_exchange_weak_explicit(&ring->head, &position, position + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (sequence < position) {
+      sched_yield();
+      position = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    } else {
+      position = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    }
+  }
+  cell->value = value;
+  atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+  size_t depth = position + 1 - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t max_depth = atomic_load_explicit(&ring->max_depth, memory_order_relaxed);
+  while (depth > max_depth && depth <= ring->mask + 1 &&
+         !atomic_compare_exchange_weak_explicit(&ring->max_depth, &max_depth, depth, memory_order_relaxed,
+                                                memory_order_relaxed))
+    ;
+
+  sem_post(&ring->filled);
+}
+
+void* ring_pop(struct Ring* ring) {
+  acquire(&ring->filled, &ring->pop_stalls);
+
+  size_t position = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  struct RingCell* cell;
+  while (1) {
+    cell = &ring->cells[position & ring->mask];
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    if (sequence == position + 1) {
+      if (atomic_compare_exchange_weak_explicit(&ring->tail, &position, position + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (sequence < position + 1) {
+      sched_yield();
+      position = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    } else {
+      position = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    }
+  }
+  void* value = cell->value;
+  atomic_store_explicit(&cell->sequence, position + ring->mask + 1, memory_order_release);
+
+  sem_post(&ring->free);
+  return value;
+}
+
+void ring_destroy(struct Ring* ring) {
+  sem_destroy(&ring->filled);
+  sem_destroy(&ring->free);
+  free(ring->cells);
+}
@@ -0,0 +1,53 @@
+#ifndef EMS_RING_H
+#define EMS_RING_H
+
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Cell of a ring. Its sequence number tells whose turn it is: the producer of position p finds p, the
+// consumer of position p finds p + 1.
+struct RingCell {
+  atomic_size_t sequence;
+  void* value;
+};
+
+// Bounded multi-producer multi-consumer queue of pointers. Positions are claimed with a compare-and-swap
+// and cells are handed over through their sequence numbers, so producers and consumers never take a lock.
+// Semaphores count the filled and free cells, and only a thread that finds none sleeps on them.
+struct Ring {
+  struct RingCell* cells;
+  size_t mask;  // Capacity minus one, the capacity being a power of two
+
+  _Alignas(64) atomic_size_t head;  // Next position to push to
+  _Alignas(64) atomic_size_t tail;  // Next position to pop from
+
+  sem_t filled;  // Cells holding a value
+  sem_t free;    // Cells that can be pushed to
+
+  atomic_ulong push_stalls;  // Pushes that had to wait for a free cell
+  atomic_ulong pop_stalls;   // Pops that had to wait for a value
+  atomic_size_t max_depth;   // Largest number of values held at once
+};
+
+/// Initializes an empty ring.
+/// @param ring Ring to be initialized.
+/// @param capacity Maximum number of values held, rounded up to a power of two.
+/// @return 0 if the ring was initialized successfully, 1 otherwise.
+int ring_init(struct Ring* ring, size_t capacity);
+
+/// Pushes a value, waiting while the ring is full.
+/// @param ring Ring to push to.
+/// @param value Value to be pushed.
+void ring_push(struct Ring* ring, void* value);
+
+/// Pops the oldest value, waiting while the ring is empty.
+/// @param ring Ring to pop from.
+/// @return Value popped.
+void* ring_pop(struct Ring* ring);
+
+/// Destroys a ring, dropping any value it still holds.
+/// @param ring Ring to be destroyed.
+void ring_destroy(struct Ring* ring);
+
+#endif  // EMS_RING_H
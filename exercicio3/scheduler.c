@@ -0,0 +1,182 @@
+#include "scheduler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Milliseconds elapsed since the scheduler started.
+static uint64_t elapsed_ms(const struct Scheduler* scheduler) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t ns = (int64_t)(now.tv_sec - scheduler->start.tv_sec) * 1000000000 + (now.tv_nsec - scheduler->start.tv_nsec);
+  return (uint64_t)(ns / 1000000);
+}
+
+/// Adds a worker to the run queue.
+/// @note Must be called with the scheduler's mutex held.
+static void make_runnable(struct Scheduler* scheduler, struct Worker* worker) {
+  worker->state = WORKER_RUNNABLE;
+  worker->next = NULL;
+  if (scheduler->run_tail != NULL) {
+    scheduler->run_tail->next = worker;
+  } else {
+    scheduler->run_head = worker;
+  }
+  scheduler->run_tail = worker;
+  pthread_cond_signal(&scheduler->runnable_cond);
+}
+
+/// Suspends a worker, not in the run queue, for its pending delay, and reports the delay.
+/// @note Must be called with the scheduler's mutex held.
+static void suspend(struct Scheduler* scheduler, struct Worker* worker) {
+  worker->state = WORKER_SUSPENDED;
+  printf("thread: %u. Waited for %u ms\n", worker->id, worker->pending_ms);
+  // Ticks are whole milliseconds since start, so the wakeup is rounded up to the next one.
+  worker->timer.expires = elapsed_ms(scheduler) + worker->pending_ms + 1;
+  worker->pending_ms = 0;
+  timer_wheel_add(&scheduler->wheel, &worker->timer);
+  pthread_cond_signal(&scheduler->timer_cond);
+}
+
+static void* timer_loop(void* arg) {
+  struct Scheduler* scheduler = arg;
+  pthread_mutex_lock(&scheduler->mutex);
+  while (!scheduler->stopping) {
+    for (struct Timer* timer = timer_wheel_advance(&scheduler->wheel, elapsed_ms(scheduler)); timer != NULL;) {
+      struct Timer* next = timer->next;
+      struct Worker* worker = (struct Worker*)((char*)timer - offsetof(struct Worker, timer));
+      if (worker->pending_ms > 0) {
+        suspend(scheduler, worker);
+      } else {
+        make_runnable(scheduler, worker);
+      }
+      timer = next;
+    }
+
+    uint64_t when;
+    if (!timer_wheel_next(&scheduler->wheel, &when)) {
+      pthread_cond_wait(&scheduler->timer_cond, &scheduler->mutex);
+      continue;
+    }
+    struct timespec deadline = scheduler->start;
+    deadline.tv_sec += (time_t)(when / 1000);
+    deadline.tv_nsec += (long)(when % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&scheduler->timer_cond, &scheduler->mutex, &deadline);
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+  return NULL;
+}
+
+int scheduler_init(struct Scheduler* scheduler, unsigned int num_workers) {
+  scheduler->workers = calloc(num_workers, sizeof(struct Worker));
+  if (scheduler->workers == NULL) {
+    fprintf(stderr, "Error allocating memory for workers\n");
+    return 1;
+  }
+  scheduler->num_workers = num_workers;
+  scheduler->run_head = NULL;
+  scheduler->run_tail = NULL;
+  scheduler->stopping = 0;
+
+  pthread_mutex_init(&scheduler->mutex, NULL);
+  pthread_cond_init(&scheduler->runnable_cond, NULL);
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&scheduler->timer_cond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  clock_gettime(CLOCK_MONOTONIC, &scheduler->start);
+  timer_wheel_init(&scheduler->wheel, 0);
+  for (unsigned int i = 0; i < num_workers; i++) {
+    scheduler->workers[i].id = i + 1;
+    make_runnable(scheduler, &scheduler->workers[i]);
+  }
+
+  if (pthread_create(&scheduler->timer_thread, NULL, timer_loop, scheduler) != 0) {
+    perror("Error creating timer thread");
+    pthread_cond_destroy(&scheduler->timer_cond);
+    pthread_cond_destroy(&scheduler->runnable_cond);
+    pthread_mutex_destroy(&scheduler->mutex);
+    free(scheduler->workers);
+    return 1;
+  }
+  return 0;
+}
+
+unsigned int scheduler_acquire(struct Scheduler* scheduler) {
+  pthread_mutex_lock(&scheduler->mutex);
+  while (scheduler->run_head == NULL) {
+    pthread_cond_wait(&scheduler->runnable_cond, &scheduler->mutex);
+  }
+  struct Worker* worker = scheduler->run_head;
+  scheduler->run_head = worker->next;
+  if (scheduler->run_head == NULL) {
+    scheduler->run_tail = NULL;
+  }
+  worker->state = WORKER_RUNNING;
+  pthread_mutex_unlock(&scheduler->mutex);
+  return worker->id;
+}
+
+void scheduler_release(struct Scheduler* scheduler, unsigned int worker_id) {
+  pthread_mutex_lock(&scheduler->mutex);
+  struct Worker* worker = &scheduler->workers[worker_id - 1];
+  if (worker->pending_ms > 0) {
+    suspend(scheduler, worker);
+  } else {
+    make_runnable(scheduler, worker);
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+}
+
+/// Delays a worker.
+/// @note Must be called with the scheduler's mutex held.
+static void delay_worker(struct Scheduler* scheduler, struct Worker* worker, unsigned int delay_ms) {
+  worker->pending_ms += delay_ms;
+  if (worker->state != WORKER_RUNNABLE) return;
+
+  struct Worker** link = &scheduler->run_head;
+  struct Worker* previous = NULL;
+  while (*link != worker) {
+    previous = *link;
+    link = &(*link)->next;
+  }
+  *link = worker->next;
+  if (scheduler->run_tail == worker) {
+    scheduler->run_tail = previous;
+  }
+  suspend(scheduler, worker);
+}
+
+void scheduler_delay(struct Scheduler* scheduler, unsigned int worker_id, unsigned int delay_ms) {
+  if (delay_ms == 0 || worker_id > scheduler->num_workers) return;
+
+  pthread_mutex_lock(&scheduler->mutex);
+  if (worker_id != 0) {
+    delay_worker(scheduler, &scheduler->workers[worker_id - 1], delay_ms);
+  } else {
+    for (unsigned int i = 0; i < scheduler->num_workers; i++) {
+      delay_worker(scheduler, &scheduler->workers[i], delay_ms);
+    }
+  }
+  pthread_mutex_unlock(&scheduler->mutex);
+}
+
+void scheduler_destroy(struct Scheduler* scheduler) {
+  pthread_mutex_lock(&scheduler->mutex);
+  scheduler->stopping = 1;
+  pthread_cond_signal(&scheduler->timer_cond);
+  pthread_mutex_unlock(&scheduler->mutex);
+  pthread_join(scheduler->timer_thread, NULL);
+
+  pthread_cond_destroy(&scheduler->timer_cond);
+  pthread_cond_destroy(&scheduler->runnable_cond);
+  pthread_mutex_destroy(&scheduler->mutex);
+  free(scheduler->workers);
+}
@@ -0,0 +1,70 @@
+#ifndef EMS_SCHEDULER_H
+#define EMS_SCHEDULER_H
+
+#include <pthread.h>
+#include <time.h>
+
+#include "timerwheel.h"
+
+enum WorkerState {
+  WORKER_RUNNABLE,   // In the run queue
+  WORKER_RUNNING,    // Held by a thread
+  WORKER_SUSPENDED,  // In the timer wheel
+};
+
+// Logical worker that commands run as. WAIT suspends workers, not threads: a thread whose worker is
+// suspended goes on with any runnable worker.
+struct Worker {
+  unsigned int id;
+  enum WorkerState state;
+  unsigned int pending_ms;  // Delay to be taken once the worker stops running or wakes up
+  struct Timer timer;       // Wakes the worker up while suspended
+  struct Worker* next;      // Next worker in the run queue
+};
+
+// Hands runnable workers to threads, and wakes suspended workers up at the exact millisecond.
+struct Scheduler {
+  pthread_mutex_t mutex;
+  pthread_cond_t runnable_cond;  // Signalled when a worker becomes runnable
+  pthread_cond_t timer_cond;     // Signalled when the earliest wakeup may have changed, on CLOCK_MONOTONIC
+
+  struct Worker* workers;
+  unsigned int num_workers;
+  struct Worker* run_head;  // Runnable workers, oldest first
+  struct Worker* run_tail;
+
+  struct TimerWheel wheel;  // Suspended workers, in milliseconds since start
+  struct timespec start;
+  pthread_t timer_thread;
+  int stopping;
+};
+
+/// Initializes a scheduler with every worker runnable, and starts its timer thread.
+/// @param scheduler Scheduler to be initialized.
+/// @param num_workers Number of workers, with ids from 1 to num_workers.
+/// @return 0 if the scheduler was initialized successfully, 1 otherwise.
+int scheduler_init(struct Scheduler* scheduler, unsigned int num_workers);
+
+/// Takes a runnable worker, waiting until there is one.
+/// @param scheduler Scheduler to take the worker from.
+/// @return Id of the worker, now running.
+unsigned int scheduler_acquire(struct Scheduler* scheduler);
+
+/// Gives back a worker taken with scheduler_acquire, suspending it if it was given a delay meanwhile.
+/// @param scheduler Scheduler the worker was taken from.
+/// @param worker_id Id of the worker.
+void scheduler_release(struct Scheduler* scheduler, unsigned int worker_id);
+
+/// Delays workers by some time. A worker waiting to run is suspended right away, one running or already
+/// suspended takes the delay when it stops running or wakes up.
+/// @param scheduler Scheduler of the workers.
+/// @param worker_id Id of the worker to be delayed, 0 to delay every worker. Unknown ids are ignored.
+/// @param delay_ms Delay in milliseconds.
+void scheduler_delay(struct Scheduler* scheduler, unsigned int worker_id, unsigned int delay_ms);
+
+/// Stops the timer thread and destroys a scheduler.
+/// @note No worker may be running. Delays still pending are dropped.
+/// @param scheduler Scheduler to be destroyed.
+void scheduler_destroy(struct Scheduler* scheduler);
+
+#endif  // EMS_SCHEDULER_H
@@ -0,0 +1,95 @@
+#include "seatmap.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+/// Appends a number as a varint.
+static int append_varint(struct Buffer* output, uint64_t value) {
+  char bytes[10];
+  size_t n = 0;
+  while (value >= 0x80) {
+    bytes[n++] = (char)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  bytes[n++] = (char)value;
+  return buffer_append(output, bytes, n);
+}
+
+/// Reads a varint at *pos, advancing it past the varint.
+/// @return 0 if a varint was read, 1 if it is truncated or does not fit in 64 bits.
+static int read_varint(const char* data, size_t len, size_t* pos, uint64_t* value) {
+  *value = 0;
+  for (unsigned int shift = 0; shift < 64; shift += 7) {
+    if (*pos == len) return 1;
+    unsigned char byte = (unsigned char)data[(*pos)++];
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return 0;
+  }
+  return 1;
+}
+
+int seatmap_begin(struct Buffer* output, size_t rows, size_t cols) {
+  char version = SEATMAP_VERSION;
+  return buffer_append(output, SEATMAP_MAGIC, SEATMAP_MAGIC_LEN) != 0 || buffer_append(output, &version, 1) != 0 ||
+         append_varint(output, rows) != 0 || append_varint(output, cols) != 0;
+}
+
+void seatmap_run_init(struct SeatmapRun* run) {
+  run->seat = 0;
+  run->length = 0;
+}
+
+int seatmap_add(struct SeatmapRun* run, unsigned int seat, struct Buffer* output) {
+  if (run->length > 0 && run->seat == seat) {
+    run->length++;
+    return 0;
+  }
+
+  if (seatmap_flush(run, output) != 0) return 1;
+  run->seat = seat;
+  run->length = 1;
+  return 0;
+}
+
+int seatmap_flush(struct SeatmapRun* run, struct Buffer* output) {
+  if (run->length == 0) return 0;
+
+  int result = append_varint(output, run->seat) != 0 || append_varint(output, run->length) != 0;
+  run->length = 0;
+  return result;
+}
+
+int seatmap_decode(const char* data, size_t len, size_t* used, struct Buffer* text) {
+  size_t pos = SEATMAP_MAGIC_LEN + 1;
+  if (len < pos || memcmp(data, SEATMAP_MAGIC, SEATMAP_MAGIC_LEN) != 0 || data[SEATMAP_MAGIC_LEN] != SEATMAP_VERSION) {
+    return 1;
+  }
+
+  uint64_t rows, cols;
+  if (read_varint(data, len, &pos, &rows) != 0 || read_varint(data, len, &pos, &cols) != 0) return 1;
+
+  uint64_t seat = 0, remaining = 0;
+  for (uint64_t i = 0; i < rows; i++) {
+    for (uint64_t j = 0; j < cols; j++) {
+      while (remaining == 0) {
+        if (read_varint(data, len, &pos, &seat) != 0 || read_varint(data, len, &pos, &remaining) != 0 ||
+            seat > UINT_MAX) {
+          return 1;
+        }
+      }
+      remaining--;
+
+      if (buffer_append_uint(text, (unsigned int)seat) != 0 || (j + 1 < cols && buffer_append(text, " ", 1) != 0)) {
+        return 1;
+      }
+    }
+
+    if (buffer_append(text, "\n", 1) != 0) return 1;
+  }
+
+  // A run longer than the seats left means the map is corrupt.
+  if (remaining != 0) return 1;
+  *used = pos;
+  return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef EMS_SEATMAP_H
+#define EMS_SEATMAP_H
+
+#include <stddef.h>
+
+#include "buffer.h"
+
+// Layout of the output of SHOW BIN: SEATMAP_MAGIC, the SEATMAP_VERSION byte, the number of rows and of
+// columns, then the seats row after row as runs of equal seats, each made of the seat (the id of the
+// reservation holding it, 0 if free) followed by the number of seats in the run. Every number is a varint:
+// 7 bits per byte, least significant first, with the top bit set on every byte but the last. Runs may span
+// rows, and consecutive runs may hold the same seat.
+// The magic starts with a NUL byte, which no text output contains, so the maps can be told apart from the
+// text around them in an output file.
+#define SEATMAP_MAGIC "\0EMS"
+#define SEATMAP_MAGIC_LEN 4
+#define SEATMAP_VERSION 1
+
+// Run of equal seats being encoded.
+struct SeatmapRun {
+  unsigned int seat;  // Seat repeated in the run
+  size_t length;      // Number of seats in the run, 0 if none was added yet
+};
+
+/// Appends the header of a seat map.
+/// @param output Buffer to append the header to.
+/// @param rows Number of rows of the event.
+/// @param cols Number of columns of the event.
+/// @return 0 if the header was appended successfully, 1 otherwise.
+int seatmap_begin(struct Buffer* output, size_t rows, size_t cols);
+
+/// Starts an empty run.
+/// @param run Run to be initialized.
+void seatmap_run_init(struct SeatmapRun* run);
+
+/// Adds the next seat, appending the current run if the seat does not extend it.
+/// @param run Run being encoded.
+/// @param seat Seat to add.
+/// @param output Buffer to append finished runs to.
+/// @return 0 if the seat was added successfully, 1 otherwise.
+int seatmap_add(struct SeatmapRun* run, unsigned int seat, struct Buffer* output);
+
+/// Appends the current run, if any, and leaves it empty.
+/// @param run Run being encoded.
+/// @param output Buffer to append the run to.
+/// @return 0 if the run was appended successfully, 1 otherwise.
+int seatmap_flush(struct SeatmapRun* run, struct Buffer* output);
+
+/// Decodes a seat map into the text layout of SHOW.
+/// @param data Bytes starting with the seat map.
+/// @param len Number of bytes available.
+/// @param used Pointer to the variable to store the size of the seat map in.
+/// @param text Buffer to append the text to.
+/// @return 0 if the seat map was decoded successfully, 1 if it is malformed, truncated, or memory ran out.
+int seatmap_decode(const char* data, size_t len, size_t* used, struct Buffer* text);
+
+#endif  // EMS_SEATMAP_H
@@ -0,0 +1,239 @@
+#include "sequencer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CHAINS 64
+
+int sequencer_init(struct Sequencer* sequencer, int fd, int zero_copy) {
+  sequencer->chains = calloc(INITIAL_CHAINS, sizeof(struct EventChain));
+  if (sequencer->chains == NULL) {
+    fprintf(stderr, "Error allocating memory for sequencer\n");
+    return 1;
+  }
+  sequencer->chains_capacity = INITIAL_CHAINS;
+  sequencer->num_chains = 0;
+
+  pthread_mutex_init(&sequencer->mutex, NULL);
+  pthread_cond_init(&sequencer->completed_cond, NULL);
+  sequencer->next_sequence = 0;
+  sequencer->last_fence = 0;
+  sequencer->last_create = 0;
+  sequencer->completed_before = 0;
+  memset(sequencer->completed, 0, sizeof(sequencer->completed));
+  sequencer->next_output = 0;
+  sequencer->pending = NULL;
+  output_init(&sequencer->output, fd, zero_copy);
+  buffer_init(&sequencer->ready);
+  buffer_init(&sequencer->sending);
+  sequencer->flushing = 0;
+  return 0;
+}
+
+/// Finds the chain of an event in a table, or the free slot where it belongs.
+static struct EventChain* find_chain(struct EventChain* chains, size_t capacity, unsigned int event_id) {
+  size_t slot = (event_id * 2654435761u) & (capacity - 1);
+  while (chains[slot].last != 0 && chains[slot].event_id != event_id) {
+    slot = (slot + 1) & (capacity - 1);
+  }
+  return &chains[slot];
+}
+
+/// Makes room in the table of chains for a number of new events, keeping it at most half full.
+/// @return 0 if there is room, 1 on allocation failure.
+static int reserve_chains(struct Sequencer* sequencer, size_t num_events) {
+  if ((sequencer->num_chains + num_events) * 2 <= sequencer->chains_capacity) return 0;
+
+  size_t capacity = sequencer->chains_capacity * 2;
+  while ((sequencer->num_chains + num_events) * 2 > capacity) {
+    capacity *= 2;
+  }
+  struct EventChain* chains = calloc(capacity, sizeof(struct EventChain));
+  if (chains == NULL) return 1;
+
+  for (size_t i = 0; i < sequencer->chains_capacity; i++) {
+    if (sequencer->chains[i].last != 0) {
+      *find_chain(chains, capacity, sequencer->chains[i].event_id) = sequencer->chains[i];
+    }
+  }
+  free(sequencer->chains);
+  sequencer->chains = chains;
+  sequencer->chains_capacity = capacity;
+  return 0;
+}
+
+/// Adds a dependency on the latest command of a chain, or on the latest fence if it is more recent.
+static void depend_on(const struct Sequencer* sequencer, unsigned long last, struct Ticket* ticket) {
+  if (sequencer->last_fence > last) {
+    last = sequencer->last_fence;
+  }
+  if (last != 0) {
+    ticket->depends_on[ticket->num_dependencies++] = last - 1;
+  }
+}
+
+int sequencer_next(struct Sequencer* sequencer, const unsigned int* event_ids, size_t num_events, int creates,
+                   struct Ticket* ticket) {
+  pthread_mutex_lock(&sequencer->mutex);
+  if (reserve_chains(sequencer, num_events) != 0) {
+    pthread_mutex_unlock(&sequencer->mutex);
+    fprintf(stderr, "Error allocating memory for sequencer\n");
+    return 1;
+  }
+
+  ticket->sequence = sequencer->next_sequence++;
+  ticket->num_dependencies = 0;
+  ticket->fence = num_events == 0;
+  if (ticket->fence) {
+    sequencer->last_fence = ticket->sequence + 1;
+  }
+
+  for (size_t i = 0; i < num_events; i++) {
+    struct EventChain* chain = find_chain(sequencer->chains, sequencer->chains_capacity, event_ids[i]);
+    if (chain->last == 0) {
+      chain->event_id = event_ids[i];
+      sequencer->num_chains++;
+    } else if (chain->last == ticket->sequence + 1) {
+      // An event repeated in the command, which must not wait for itself.
+      continue;
+    }
+    depend_on(sequencer, chain->last, ticket);
+    chain->last = ticket->sequence + 1;
+  }
+  // Events are listed in the order they were added.
+  if (creates) {
+    depend_on(sequencer, sequencer->last_create, ticket);
+    sequencer->last_create = ticket->sequence + 1;
+  }
+
+  pthread_mutex_unlock(&sequencer->mutex);
+  return 0;
+}
+
+/// Whether a command has completed.
+/// @note Must be called with the sequencer's mutex held, for a command within the window.
+static int has_completed(const struct Sequencer* sequencer, unsigned long sequence) {
+  return sequence < sequencer->completed_before || sequencer->completed[sequence % SEQUENCER_WINDOW];
+}
+
+/// Whether a command may run.
+/// @note Must be called with the sequencer's mutex held.
+static int can_run(const struct Sequencer* sequencer, const struct Ticket* ticket) {
+  if (ticket->sequence >= sequencer->completed_before + SEQUENCER_WINDOW) return 0;
+  if (ticket->fence) return sequencer->completed_before == ticket->sequence;
+
+  for (size_t i = 0; i < ticket->num_dependencies; i++) {
+    if (!has_completed(sequencer, ticket->depends_on[i])) return 0;
+  }
+  return 1;
+}
+
+void sequencer_wait(struct Sequencer* sequencer, const struct Ticket* ticket) {
+  pthread_mutex_lock(&sequencer->mutex);
+  while (!can_run(sequencer, ticket)) {
+    pthread_cond_wait(&sequencer->completed_cond, &sequencer->mutex);
+  }
+  pthread_mutex_unlock(&sequencer->mutex);
+}
+
+/// Keeps the output of a command that completed before an earlier one.
+/// @return 0 if the output was kept, 1 on allocation failure.
+static int hold_output(struct Sequencer* sequencer, const struct Ticket* ticket, struct Buffer* output) {
+  struct PendingOutput* pending = malloc(sizeof(struct PendingOutput));
+  if (pending == NULL) return 1;
+
+  pending->sequence = ticket->sequence;
+  pending->output = *output;
+  buffer_init(output);
+
+  struct PendingOutput** link = &sequencer->pending;
+  while (*link != NULL && (*link)->sequence < ticket->sequence) {
+    link = &(*link)->next;
+  }
+  pending->next = *link;
+  *link = pending;
+  return 0;
+}
+
+void sequencer_complete(struct Sequencer* sequencer, const struct Ticket* ticket, struct Buffer* output) {
+  pthread_mutex_lock(&sequencer->mutex);
+
+  sequencer->completed[ticket->sequence % SEQUENCER_WINDOW] = 1;
+  while (sequencer->completed[sequencer->completed_before % SEQUENCER_WINDOW]) {
+    sequencer->completed[sequencer->completed_before % SEQUENCER_WINDOW] = 0;
+    sequencer->completed_before++;
+  }
+  pthread_cond_broadcast(&sequencer->completed_cond);
+
+  // Waiting for an output is not an option: the command it belongs to may be waiting for this one.
+  while (ticket->sequence != sequencer->next_output && hold_output(sequencer, ticket, output) != 0) {
+    pthread_cond_wait(&sequencer->completed_cond, &sequencer->mutex);
+  }
+  if (ticket->sequence != sequencer->next_output) {
+    pthread_mutex_unlock(&sequencer->mutex);
+    return;
+  }
+
+  // An output that is the only one ready is taken whole rather than copied, so large ones reach the file
+  // from the buffer they were rendered in.
+  if (sequencer->ready.len == 0) {
+    struct Buffer swap = sequencer->ready;
+    sequencer->ready = *output;
+    *output = swap;
+  } else if (buffer_append(&sequencer->ready, output->data, output->len) != 0) {
+    fprintf(stderr, "Error allocating memory for output\n");
+  }
+  output->len = 0;
+  sequencer->next_output++;
+
+  while (sequencer->pending != NULL && sequencer->pending->sequence == sequencer->next_output) {
+    struct PendingOutput* pending = sequencer->pending;
+    if (buffer_append(&sequencer->ready, pending->output.data, pending->output.len) != 0) {
+      fprintf(stderr, "Error allocating memory for output\n");
+    }
+    sequencer->pending = pending->next;
+    buffer_free(&pending->output);
+    free(pending);
+    sequencer->next_output++;
+  }
+  pthread_cond_broadcast(&sequencer->completed_cond);
+
+  // The first thread to complete in order writes, the others leave their outputs to it.
+  if (sequencer->flushing) {
+    pthread_mutex_unlock(&sequencer->mutex);
+    return;
+  }
+
+  sequencer->flushing = 1;
+  while (sequencer->ready.len > 0) {
+    struct Buffer swap = sequencer->sending;
+    sequencer->sending = sequencer->ready;
+    sequencer->ready = swap;
+    sequencer->ready.len = 0;
+    pthread_mutex_unlock(&sequencer->mutex);
+
+    if (output_write(&sequencer->output, sequencer->sending.data, sequencer->sending.len) != 0) {
+      perror("Error writing output");
+    }
+
+    pthread_mutex_lock(&sequencer->mutex);
+  }
+  sequencer->flushing = 0;
+  pthread_mutex_unlock(&sequencer->mutex);
+}
+
+void sequencer_destroy(struct Sequencer* sequencer) {
+  while (sequencer->pending != NULL) {
+    struct PendingOutput* pending = sequencer->pending;
+    sequencer->pending = pending->next;
+    buffer_free(&pending->output);
+    free(pending);
+  }
+  buffer_free(&sequencer->ready);
+  buffer_free(&sequencer->sending);
+  output_destroy(&sequencer->output);
+  free(sequencer->chains);
+  pthread_cond_destroy(&sequencer->completed_cond);
+  pthread_mutex_destroy(&sequencer->mutex);
+}
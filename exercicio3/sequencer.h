@@ -0,0 +1,94 @@
+#ifndef EMS_SEQUENCER_H
+#define EMS_SEQUENCER_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "buffer.h"
+#include "constants.h"
+#include "output.h"
+
+// Output of a command that completed before some command read earlier.
+struct PendingOutput {
+  unsigned long sequence;
+  struct Buffer output;
+  struct PendingOutput* next;
+};
+
+// Latest command read that uses an event.
+struct EventChain {
+  unsigned int event_id;
+  unsigned long last;  // Sequence number of the command, plus one (0 if the slot is free)
+};
+
+// Makes commands executed by several threads behave as if executed one by one, in the order they were
+// read: commands that use the same event run in that order, and so do commands adding events to the list
+// of events; other commands run at the same time, a fence runs alone after every earlier command, and
+// outputs are written in order.
+struct Sequencer {
+  pthread_mutex_t mutex;
+  pthread_cond_t completed_cond;  // Signalled when commands complete
+
+  unsigned long next_sequence;  // Sequence number of the next command read
+  unsigned long last_fence;     // Sequence number of the latest fence read, plus one (0 if none)
+  unsigned long last_create;    // Sequence number of the latest command adding an event, plus one (0 if none)
+  struct EventChain* chains;    // Hash table of the latest command on each event, by event id
+  size_t chains_capacity;       // Number of slots of chains, a power of two
+  size_t num_chains;            // Number of slots of chains in use
+
+  unsigned long completed_before;                // Every command before this one has completed
+  unsigned char completed[SEQUENCER_WINDOW];     // Whether each command of the window has completed
+
+  unsigned long next_output;      // Sequence number of the next command to output
+  struct PendingOutput* pending;  // Outputs completed out of order, sorted by sequence number
+
+  struct Output output;   // Where outputs are written
+  struct Buffer ready;    // Outputs in order, waiting to be written
+  struct Buffer sending;  // Outputs being written, owned by the thread that is flushing
+  int flushing;           // Whether a thread is writing to the output
+};
+
+// Place of a command in the sequence.
+struct Ticket {
+  unsigned long sequence;                         // Sequence number of the command
+  unsigned long depends_on[MAX_MULTI_EVENTS + 1];  // Sequence numbers of the commands it runs after
+  size_t num_dependencies;
+  int fence;  // Whether it runs after every earlier command
+};
+
+/// Initializes a sequencer.
+/// @param sequencer Sequencer to be initialized.
+/// @param fd File descriptor to write the outputs to.
+/// @param zero_copy Whether to splice large outputs into fd, see struct Output.
+/// @return 0 if the sequencer was initialized successfully, 1 otherwise.
+int sequencer_init(struct Sequencer* sequencer, int fd, int zero_copy);
+
+/// Gives the next command read its place in the sequence.
+/// @note Must be called in the order commands are read.
+/// @param sequencer Sequencer to be used.
+/// @param event_ids Events the command uses.
+/// @param num_events Number of events, 0 for a fence, which may use every event.
+/// @param creates Whether the command changes the list of events.
+/// @param ticket Pointer to the ticket to store the place of the command in.
+/// @return 0 if the command got a ticket, 1 on allocation failure.
+int sequencer_next(struct Sequencer* sequencer, const unsigned int* event_ids, size_t num_events, int creates,
+                   struct Ticket* ticket);
+
+/// Waits until the commands a command depends on have completed, and until it is close enough to the
+/// earliest command still running for the sequencer to keep track of it.
+/// @param sequencer Sequencer to be used.
+/// @param ticket Ticket of the command.
+void sequencer_wait(struct Sequencer* sequencer, const struct Ticket* ticket);
+
+/// Completes a command, writing its output once every earlier output has been written.
+/// @param sequencer Sequencer to be used.
+/// @param ticket Ticket of the command.
+/// @param output Output of the command. It is left empty, possibly with a new allocation.
+void sequencer_complete(struct Sequencer* sequencer, const struct Ticket* ticket, struct Buffer* output);
+
+/// Destroys a sequencer.
+/// @note Every command must have completed.
+/// @param sequencer Sequencer to be destroyed.
+void sequencer_destroy(struct Sequencer* sequencer);
+
+#endif  // EMS_SEQUENCER_H
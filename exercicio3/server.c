@@ -0,0 +1,445 @@
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "operations.h"
+#include "protocol.h"
+
+#define MAX_EPOLL_EVENTS 64
+
+// A connected client.
+struct Session {
+  int request_fd;         // Read by the event loop only
+  int response_fd;        // Written by the worker that is flushing
+  struct Buffer input;    // Bytes read from request_fd that do not form a whole request yet
+  unsigned int refs;      // Queued requests, plus one while request_fd is open
+  pthread_mutex_t write_lock;  // Guards output and flushing
+  struct Buffer output;   // Responses waiting for the next write
+  struct Buffer sending;  // Responses being written, owned by the flushing worker
+  int flushing;           // Whether a worker is writing to response_fd
+  struct Session* next;  // Next session in the server's list
+};
+
+// A request waiting for a worker.
+struct Job {
+  struct Session* session;
+  uint32_t sequence;
+  uint32_t type;
+  uint32_t num_fields;
+  uint32_t* fields;
+  struct Job* next;
+};
+
+static pthread_mutex_t server_mutex = PTHREAD_MUTEX_INITIALIZER;  // Guards the queue, sessions and refs
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;       // Signalled when a job is queued
+static struct Job* queue_head = NULL;
+static struct Job* queue_tail = NULL;
+static struct Session* sessions = NULL;
+static int stopping = 0;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handle_stop_signal(int signal) {
+  (void)signal;
+  interrupted = 1;
+}
+
+static void free_session(struct Session* session) {
+  if (session->request_fd >= 0) {
+    close(session->request_fd);
+  }
+  close(session->response_fd);
+  buffer_free(&session->input);
+  buffer_free(&session->output);
+  buffer_free(&session->sending);
+  pthread_mutex_destroy(&session->write_lock);
+  free(session);
+}
+
+/// Drops a reference to a session, freeing it once the client is gone and its requests are answered.
+static void release_session(struct Session* session) {
+  pthread_mutex_lock(&server_mutex);
+  int unused = --session->refs == 0;
+  if (unused) {
+    struct Session** link = &sessions;
+    while (*link != session) {
+      link = &(*link)->next;
+    }
+    *link = session->next;
+  }
+  pthread_mutex_unlock(&server_mutex);
+
+  if (unused) {
+    free_session(session);
+  }
+}
+
+/// Executes a request against the state.
+/// @param job Request to be executed.
+/// @param output Buffer to append the output of the request to.
+/// @return 0 if the operation succeeded, 1 otherwise.
+static int execute(const struct Job* job, struct Buffer* output) {
+  const uint32_t* fields = job->fields;
+  size_t num_fields = job->num_fields;
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+
+  switch ((enum RequestType)job->type) {
+    case REQUEST_CREATE:
+      if (num_fields != 3) break;
+      return ems_create(fields[0], fields[1], fields[2]);
+
+    case REQUEST_RESERVE:
+      if (protocol_decode_reservation(fields, num_fields, xs, ys, MAX_RESERVATION_SIZE) != num_fields) break;
+      return ems_reserve(fields[0], fields[1], xs, ys);
+
+    case REQUEST_RESERVE_BEST:
+      if (num_fields != 3 || fields[1] == 0 || fields[1] > MAX_RESERVATION_SIZE) break;
+      return ems_reserve_best(fields[0], fields[1], fields[2] != 0);
+
+    case REQUEST_RESERVE_MULTI: {
+      if (num_fields == 0 || fields[0] == 0 || fields[0] > MAX_MULTI_EVENTS) break;
+      unsigned int event_ids[MAX_MULTI_EVENTS];
+      size_t num_seats[MAX_MULTI_EVENTS];
+      size_t used = 1, total = 0, n = 0;
+      for (; n < fields[0]; n++) {
+        // The seats of every event share xs and ys, so each event only gets the room the others left.
+        if (used + 1 >= num_fields || fields[used + 1] > MAX_RESERVATION_SIZE - total) break;
+        size_t size = protocol_decode_reservation(fields + used, num_fields - used, xs + total, ys + total,
+                                                  MAX_RESERVATION_SIZE - total);
+        if (size == 0) break;
+        event_ids[n] = fields[used];
+        num_seats[n] = fields[used + 1];
+        total += num_seats[n];
+        used += size;
+      }
+      if (n != fields[0] || used != num_fields) break;
+      return ems_reserve_multi(n, event_ids, num_seats, xs, ys);
+    }
+
+    case REQUEST_SHOW:
+      if (num_fields != 1) break;
+      return ems_render_show(fields[0], output);
+
+    case REQUEST_QUERY:
+      if (num_fields != 2) break;
+      return ems_render_query(fields[0], fields[1], output);
+
+    case REQUEST_CANCEL:
+      if (num_fields != 2) break;
+      return ems_cancel(fields[0], fields[1]);
+
+    case REQUEST_LIST:
+      if (num_fields != 0) break;
+      return ems_render_list_events(output);
+
+    case REQUEST_STATS_MEM:
+      if (num_fields != 0) break;
+      return ems_render_mem_stats(output);
+
+    case REQUEST_DELETE:
+      if (num_fields != 1) break;
+      return ems_delete(fields[0]);
+
+    case REQUEST_SHOW_BIN:
+      if (num_fields != 1) break;
+      return ems_render_show_bin(fields[0], output);
+  }
+
+  fprintf(stderr, "Invalid request\n");
+  return 1;
+}
+
+/// Queues a response and writes it unless another worker is already writing to the session. That
+/// worker then picks it up with whatever else completed meanwhile, in a single write.
+/// @param session Session to answer.
+/// @param header Header of the response.
+/// @param output Output of the request.
+static void send_response(struct Session* session, const struct ResponseHeader* header, const struct Buffer* output) {
+  pthread_mutex_lock(&session->write_lock);
+  if (buffer_append(&session->output, (const char*)header, sizeof(*header)) != 0 ||
+      buffer_append(&session->output, output->data, output->len) != 0) {
+    fprintf(stderr, "Error allocating memory for response\n");
+  }
+  if (session->flushing) {
+    pthread_mutex_unlock(&session->write_lock);
+    return;
+  }
+
+  session->flushing = 1;
+  while (session->output.len > 0) {
+    struct Buffer swap = session->sending;
+    session->sending = session->output;
+    session->output = swap;
+    session->output.len = 0;
+    pthread_mutex_unlock(&session->write_lock);
+
+    // A client that went away only loses its own responses.
+    if (write_all(session->response_fd, session->sending.data, session->sending.len) != 0) {
+      perror("Error writing response");
+    }
+
+    pthread_mutex_lock(&session->write_lock);
+  }
+  session->flushing = 0;
+  pthread_mutex_unlock(&session->write_lock);
+}
+
+static void* worker_loop(void* arg) {
+  (void)arg;
+
+  struct Buffer output;
+  buffer_init(&output);
+
+  while (1) {
+    pthread_mutex_lock(&server_mutex);
+    while (queue_head == NULL && !stopping) {
+      pthread_cond_wait(&job_cond, &server_mutex);
+    }
+    struct Job* job = queue_head;
+    if (job == NULL) {
+      pthread_mutex_unlock(&server_mutex);
+      break;
+    }
+    queue_head = job->next;
+    if (queue_head == NULL) {
+      queue_tail = NULL;
+    }
+    pthread_mutex_unlock(&server_mutex);
+
+    output.len = 0;
+    struct ResponseHeader header;
+    header.sequence = job->sequence;
+    header.status = execute(job, &output);
+    header.length = (uint32_t)output.len;
+    send_response(job->session, &header, &output);
+
+    release_session(job->session);
+    free(job->fields);
+    free(job);
+  }
+
+  buffer_free(&output);
+  return NULL;
+}
+
+/// Queues every whole request in the input of a session.
+/// @return 0 if the input is well formed, 1 if the session must be dropped.
+static int queue_requests(struct Session* session) {
+  size_t position = 0;
+  while (session->input.len - position >= sizeof(struct RequestHeader)) {
+    struct RequestHeader header;
+    memcpy(&header, session->input.data + position, sizeof(header));
+    if (header.num_fields > MAX_REQUEST_FIELDS) {
+      fprintf(stderr, "Request too large\n");
+      return 1;
+    }
+
+    size_t size = header.num_fields * sizeof(uint32_t);
+    if (session->input.len - position - sizeof(header) < size) break;
+
+    struct Job* job = malloc(sizeof(struct Job));
+    uint32_t* fields = malloc(size ? size : 1);
+    if (job == NULL || fields == NULL) {
+      fprintf(stderr, "Error allocating memory for request\n");
+      free(job);
+      free(fields);
+      return 1;
+    }
+    memcpy(fields, session->input.data + position + sizeof(header), size);
+    *job = (struct Job){session, header.sequence, header.type, header.num_fields, fields, NULL};
+    position += sizeof(header) + size;
+
+    pthread_mutex_lock(&server_mutex);
+    session->refs++;
+    if (queue_tail) {
+      queue_tail->next = job;
+    } else {
+      queue_head = job;
+    }
+    queue_tail = job;
+    pthread_cond_signal(&job_cond);
+    pthread_mutex_unlock(&server_mutex);
+  }
+
+  memmove(session->input.data, session->input.data + position, session->input.len - position);
+  session->input.len -= position;
+  return 0;
+}
+
+/// Stops reading from a session. It is freed once its queued requests are answered.
+static void close_session(int epoll_fd, struct Session* session) {
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->request_fd, NULL);
+  close(session->request_fd);
+  session->request_fd = -1;
+  release_session(session);
+}
+
+/// Reads whatever a client sent and queues the requests it completes.
+static void read_session(int epoll_fd, struct Session* session) {
+  char chunk[4096];
+  while (1) {
+    ssize_t bytes = read(session->request_fd, chunk, sizeof(chunk));
+    if (bytes < 0 && errno == EINTR) continue;
+    if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+    if (bytes <= 0 || buffer_append(&session->input, chunk, (size_t)bytes) != 0 || queue_requests(session) != 0) {
+      close_session(epoll_fd, session);
+      return;
+    }
+  }
+}
+
+/// Opens the FIFOs of a client that registered and starts reading its requests.
+static void open_session(int epoll_fd, struct Registration* registration) {
+  registration->request_path[MAX_PIPE_PATH_LEN - 1] = '\0';
+  registration->response_path[MAX_PIPE_PATH_LEN - 1] = '\0';
+
+  struct Session* session = malloc(sizeof(struct Session));
+  if (session == NULL) {
+    fprintf(stderr, "Error allocating memory for session\n");
+    return;
+  }
+
+  // The client already has the response FIFO open for reading, so neither open can block the loop.
+  session->response_fd = open(registration->response_path, O_WRONLY | O_NONBLOCK);
+  if (session->response_fd < 0) {
+    perror("Error opening response pipe");
+    free(session);
+    return;
+  }
+  fcntl(session->response_fd, F_SETFL, 0);
+
+  session->request_fd = open(registration->request_path, O_RDONLY | O_NONBLOCK);
+  if (session->request_fd < 0) {
+    perror("Error opening request pipe");
+    close(session->response_fd);
+    free(session);
+    return;
+  }
+
+  buffer_init(&session->input);
+  buffer_init(&session->output);
+  buffer_init(&session->sending);
+  session->flushing = 0;
+  session->refs = 1;
+  pthread_mutex_init(&session->write_lock, NULL);
+
+  pthread_mutex_lock(&server_mutex);
+  session->next = sessions;
+  sessions = session;
+  pthread_mutex_unlock(&server_mutex);
+
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = session};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, session->request_fd, &event) != 0) {
+    perror("Error watching request pipe");
+    close_session(epoll_fd, session);
+  }
+}
+
+/// Accepts every pending registration.
+static void read_registrations(int epoll_fd, int registration_fd) {
+  struct Registration registration;
+  while (1) {
+    ssize_t bytes = read(registration_fd, &registration, sizeof(registration));
+    if (bytes < 0 && errno == EINTR) continue;
+    if (bytes != (ssize_t)sizeof(registration)) {
+      if (bytes > 0) {
+        fprintf(stderr, "Invalid registration\n");
+      }
+      return;
+    }
+    open_session(epoll_fd, &registration);
+  }
+}
+
+/// Waits for registrations and requests, handing every whole request to the workers.
+static void event_loop(int epoll_fd, int registration_fd) {
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  while (!interrupted) {
+    int ready = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      perror("Error waiting for requests");
+      return;
+    }
+
+    for (int i = 0; i < ready; i++) {
+      if (events[i].data.ptr == NULL) {
+        read_registrations(epoll_fd, registration_fd);
+      } else {
+        read_session(epoll_fd, events[i].data.ptr);
+      }
+    }
+  }
+}
+
+int server_run(const char* registration_path, int num_workers) {
+  if (mkfifo(registration_path, S_IRUSR | S_IWUSR) != 0 && errno != EEXIST) {
+    perror("Error creating registration pipe");
+    return 1;
+  }
+
+  // Opened for writing as well, so the pipe never reports end of file between clients.
+  int registration_fd = open(registration_path, O_RDWR | O_NONBLOCK);
+  int epoll_fd = epoll_create1(0);
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+  if (registration_fd < 0 || epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, registration_fd, &event) != 0) {
+    perror("Error starting server");
+    if (registration_fd >= 0) close(registration_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handle_stop_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  action.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &action, NULL);
+
+  pthread_t* workers = malloc((size_t)num_workers * sizeof(pthread_t));
+  int started = 0;
+  stopping = 0;
+  interrupted = 0;
+  while (workers != NULL && started < num_workers && pthread_create(&workers[started], NULL, worker_loop, NULL) == 0) {
+    started++;
+  }
+
+  if (started > 0) {
+    event_loop(epoll_fd, registration_fd);
+  } else {
+    fprintf(stderr, "Error creating worker threads\n");
+  }
+
+  // Requests already received are still answered.
+  pthread_mutex_lock(&server_mutex);
+  stopping = 1;
+  pthread_cond_broadcast(&job_cond);
+  pthread_mutex_unlock(&server_mutex);
+  for (int i = 0; i < started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+
+  while (sessions != NULL) {
+    struct Session* session = sessions;
+    sessions = session->next;
+    free_session(session);
+  }
+
+  close(epoll_fd);
+  close(registration_fd);
+  unlink(registration_path);
+  return started > 0 ? 0 : 1;
+}
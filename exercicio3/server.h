@@ -0,0 +1,11 @@
+#ifndef EMS_SERVER_H
+#define EMS_SERVER_H
+
+/// Serves requests against the EMS state until SIGINT or SIGTERM is received.
+/// @note The state must be initialized with ems_init before, and is left initialized.
+/// @param registration_path Path of the FIFO clients register through, created if it does not exist.
+/// @param num_workers Number of threads executing requests.
+/// @return 0 if the server shut down cleanly, 1 if it could not be started.
+int server_run(const char* registration_path, int num_workers);
+
+#endif  // EMS_SERVER_H
@@ -0,0 +1,192 @@
+#include "shard.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define INITIAL_ORDER_CAPACITY 64
+
+/// Stops the shards started so far and frees them.
+static void stop_started(struct Shards* shards) {
+  for (unsigned int i = 0; i < shards->count; i++) {
+    if (shards->pids[i] > 0) {
+      kill(shards->pids[i], SIGTERM);
+    }
+  }
+  for (unsigned int i = 0; i < shards->count; i++) {
+    int status;
+    if (shards->pids[i] > 0 && waitpid(shards->pids[i], &status, 0) == shards->pids[i] &&
+        !(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+      fprintf(stderr, "Shard %u failed\n", i);
+    }
+    unlink(shards->paths[i]);
+  }
+  free(shards->pids);
+  free(shards->paths);
+  free(shards->order);
+  pthread_mutex_destroy(&shards->order_mutex);
+}
+
+int shards_start(struct Shards* shards, unsigned int count, shard_serve_fn serve, void* arg) {
+  shards->count = count;
+  shards->pids = calloc(count, sizeof(pid_t));
+  shards->paths = calloc(count, sizeof(*shards->paths));
+  shards->order = NULL;
+  shards->num_ordered = 0;
+  shards->order_capacity = 0;
+  pthread_mutex_init(&shards->order_mutex, NULL);
+  if (shards->pids == NULL || shards->paths == NULL) {
+    fprintf(stderr, "Error allocating memory for shards\n");
+    shards->count = 0;
+    stop_started(shards);
+    return 1;
+  }
+
+  // Buffered output would otherwise be written again by every shard.
+  fflush(stdout);
+  fflush(stderr);
+  for (unsigned int i = 0; i < count; i++) {
+    // Created before forking, so that connecting never races with the shard creating it.
+    snprintf(shards->paths[i], MAX_PIPE_PATH_LEN, "/tmp/ems_%d_shard%u.reg", getpid(), i);
+    if (mkfifo(shards->paths[i], S_IRUSR | S_IWUSR) != 0 && errno != EEXIST) {
+      perror("Error creating shard pipe");
+      stop_started(shards);
+      return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("Error starting shard");
+      stop_started(shards);
+      return 1;
+    }
+    if (pid == 0) {
+      _exit(serve(shards->paths[i], arg));
+    }
+    shards->pids[i] = pid;
+  }
+  return 0;
+}
+
+void shards_stop(struct Shards* shards) { stop_started(shards); }
+
+unsigned int shard_of(const struct Shards* shards, unsigned int event_id) {
+  // Scrambles consecutive ids, then maps the hash to a shard without a division.
+  uint32_t hash = event_id * 2654435761u;
+  return (unsigned int)(((uint64_t)hash * shards->count) >> 32);
+}
+
+int shards_record(struct Shards* shards, unsigned int event_id, int created) {
+  pthread_mutex_lock(&shards->order_mutex);
+  if (!created) {
+    for (size_t i = 0; i < shards->num_ordered; i++) {
+      if (shards->order[i] == event_id) {
+        memmove(shards->order + i, shards->order + i + 1, (shards->num_ordered - i - 1) * sizeof(unsigned int));
+        shards->num_ordered--;
+        break;
+      }
+    }
+    pthread_mutex_unlock(&shards->order_mutex);
+    return 0;
+  }
+
+  if (shards->num_ordered == shards->order_capacity) {
+    size_t capacity = shards->order_capacity ? 2 * shards->order_capacity : INITIAL_ORDER_CAPACITY;
+    unsigned int* order = realloc(shards->order, capacity * sizeof(unsigned int));
+    if (order == NULL) {
+      pthread_mutex_unlock(&shards->order_mutex);
+      fprintf(stderr, "Error allocating memory for event order\n");
+      return 1;
+    }
+    shards->order = order;
+    shards->order_capacity = capacity;
+  }
+  shards->order[shards->num_ordered++] = event_id;
+  pthread_mutex_unlock(&shards->order_mutex);
+  return 0;
+}
+
+static int compare_ids(const void* a, const void* b) {
+  unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+  return (x > y) - (x < y);
+}
+
+/// Reads the ids of the "Event: <id>" lines of a listing.
+/// @param listing Listing to be read, NUL terminated.
+/// @param ids Pointer to the array to store the ids in, grown as needed.
+/// @param num_ids Pointer to the number of ids stored.
+/// @param capacity Pointer to the number of ids allocated.
+/// @return 0 if the listing was read, 1 on allocation failure.
+static int read_listing(const char* listing, unsigned int** ids, size_t* num_ids, size_t* capacity) {
+  for (const char* line = listing; line != NULL && *line != '\0';) {
+    if (strncmp(line, "Event: ", 7) == 0) {
+      if (*num_ids == *capacity) {
+        *capacity = *capacity ? 2 * *capacity : INITIAL_ORDER_CAPACITY;
+        unsigned int* grown = realloc(*ids, *capacity * sizeof(unsigned int));
+        if (grown == NULL) return 1;
+        *ids = grown;
+      }
+      (*ids)[(*num_ids)++] = (unsigned int)strtoul(line + 7, NULL, 10);
+    }
+    line = strchr(line, '\n');
+    line = line ? line + 1 : NULL;
+  }
+  return 0;
+}
+
+int shards_list_events(struct Shards* shards, struct Session* sessions, struct Buffer* output) {
+  struct Buffer listing;
+  buffer_init(&listing);
+  unsigned int* ids = NULL;
+  size_t num_ids = 0, capacity = 0;
+  int result = 0;
+  for (unsigned int i = 0; i < shards->count && result == 0; i++) {
+    listing.len = 0;
+    result = client_list_events(&sessions[i], &listing) != 0 || buffer_append(&listing, "", 1) != 0 ||
+             read_listing(listing.data, &ids, &num_ids, &capacity) != 0;
+  }
+  buffer_free(&listing);
+  if (result != 0) {
+    free(ids);
+    return 1;
+  }
+
+  // Each shard lists its own events in creation order; the events of every shard are merged in the order
+  // they were created. Without events, ids is still NULL.
+  int listed = 0;
+  if (num_ids > 0) {
+    qsort(ids, num_ids, sizeof(unsigned int), compare_ids);
+    pthread_mutex_lock(&shards->order_mutex);
+    for (size_t i = 0; i < shards->num_ordered && result == 0; i++) {
+      if (bsearch(&shards->order[i], ids, num_ids, sizeof(unsigned int), compare_ids) == NULL) continue;
+      result = buffer_append(output, "Event: ", 7) != 0 || buffer_append_uint(output, shards->order[i]) != 0 ||
+               buffer_append(output, "\n", 1) != 0;
+      listed = 1;
+    }
+    pthread_mutex_unlock(&shards->order_mutex);
+  }
+  free(ids);
+
+  if (result == 0 && !listed) {
+    char msg[] = "No events\n";
+    result = buffer_append(output, msg, sizeof(msg) - 1);  // sizeof(msg) - 1 to exclude the null terminator
+  }
+  return result;
+}
+
+int shards_mem_stats(const struct Shards* shards, struct Session* sessions, struct Buffer* output) {
+  for (unsigned int i = 0; i < shards->count; i++) {
+    char header[32];
+    int length = snprintf(header, sizeof(header), "shard %u:\n", i);
+    if (buffer_append(output, header, (size_t)length) != 0 || client_mem_stats(&sessions[i], output) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef EMS_SHARD_H
+#define EMS_SHARD_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "buffer.h"
+#include "client.h"
+#include "protocol.h"
+
+#define MAX_SHARDS 64
+
+// Processes that split the events of a job file between them by id. Each one serves its events as a
+// server of its own, and the threads running the job file send every command to the shard owning its event.
+struct Shards {
+  unsigned int count;                 // Number of shard processes
+  pid_t* pids;                        // Shard processes, 0 if not running
+  char (*paths)[MAX_PIPE_PATH_LEN];   // Registration FIFO of each shard
+  pthread_mutex_t order_mutex;        // Guards the creation order
+  unsigned int* order;                // Ids of the events, in the order they were created
+  size_t num_ordered;                 // Number of ids in order
+  size_t order_capacity;              // Number of ids allocated for order
+};
+
+/// Serves the requests of one shard until it is told to stop, in a process of its own.
+/// @param registration_path Registration FIFO to serve.
+/// @param arg Argument given to shards_start.
+/// @return Exit status of the shard process.
+typedef int (*shard_serve_fn)(const char* registration_path, void* arg);
+
+/// Starts the shard processes.
+/// @param shards Shards to be started.
+/// @param count Number of shards.
+/// @param serve Function run by each shard process.
+/// @param arg Argument for serve.
+/// @return 0 if every shard was started, 1 otherwise (and none is left running).
+int shards_start(struct Shards* shards, unsigned int count, shard_serve_fn serve, void* arg);
+
+/// Stops the shard processes once the requests they already received are answered, and frees the shards.
+/// @param shards Shards to be stopped.
+void shards_stop(struct Shards* shards);
+
+/// Shard owning an event.
+/// @param shards Shards the events are split between.
+/// @param event_id Id of the event.
+/// @return Index of the shard, from 0 to shards->count - 1.
+unsigned int shard_of(const struct Shards* shards, unsigned int event_id);
+
+/// Records that an event was created or deleted, so that LIST keeps the order of the events across shards.
+/// @note Must be called in the order the events are created and deleted.
+/// @param shards Shards the events are split between.
+/// @param event_id Id of the event.
+/// @param created 1 if the event was created, 0 if it was deleted.
+/// @return 0 if the change was recorded, 1 on allocation failure.
+int shards_record(struct Shards* shards, unsigned int event_id, int created);
+
+/// Same as ems_render_list_events, gathering the events of every shard.
+/// @param shards Shards the events are split between.
+/// @param sessions Sessions of the calling thread with every shard, indexed by shard.
+/// @param output Buffer to append the list to.
+/// @return 0 if the events were listed successfully, 1 otherwise.
+int shards_list_events(struct Shards* shards, struct Session* sessions, struct Buffer* output);
+
+/// Same as ems_render_mem_stats, with the memory used by each shard.
+/// @param shards Shards the events are split between.
+/// @param sessions Sessions of the calling thread with every shard, indexed by shard.
+/// @param output Buffer to append the statistics to.
+/// @return 0 if the statistics were gathered successfully, 1 otherwise.
+int shards_mem_stats(const struct Shards* shards, struct Session* sessions, struct Buffer* output);
+
+#endif  // EMS_SHARD_H
@@ -0,0 +1,78 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "seatmap.h"
+
+/// Reads a whole file into a buffer.
+/// @return 0 if the file was read, 1 otherwise.
+static int read_file(int fd, struct Buffer* contents) {
+  char chunk[1 << 16];
+  while (1) {
+    ssize_t bytes_read = read(fd, chunk, sizeof(chunk));
+    if (bytes_read < 0) {
+      if (errno == EINTR) continue;
+      return 1;
+    }
+    if (bytes_read == 0) return 0;
+    if (buffer_append(contents, chunk, (size_t)bytes_read) != 0) return 1;
+  }
+}
+
+/// Copies an output file to stdout, turning the seat maps of SHOW BIN into the text SHOW prints.
+int main(int argc, char* argv[]) {
+  if (argc > 2) {
+    fprintf(stderr, "Usage: %s [output_file]\n", argv[0]);
+    return 1;
+  }
+
+  int fd = argc > 1 ? open(argv[1], O_RDONLY) : STDIN_FILENO;
+  if (fd < 0) {
+    perror("Error opening output file");
+    return 1;
+  }
+
+  struct Buffer contents, text;
+  buffer_init(&contents);
+  buffer_init(&text);
+  int result = read_file(fd, &contents);
+  if (result != 0) {
+    perror("Error reading output file");
+  }
+  if (fd != STDIN_FILENO) {
+    close(fd);
+  }
+
+  for (size_t pos = 0; result == 0 && pos < contents.len;) {
+    // Text never contains a NUL byte, so one starts a seat map.
+    const char* start = memchr(contents.data + pos, '\0', contents.len - pos);
+    size_t text_len = start ? (size_t)(start - contents.data) - pos : contents.len - pos;
+    if (write_all(STDOUT_FILENO, contents.data + pos, text_len) != 0) {
+      perror("Error writing output");
+      result = 1;
+      break;
+    }
+    pos += text_len;
+    if (start == NULL) break;
+
+    size_t used;
+    text.len = 0;
+    if (seatmap_decode(start, contents.len - pos, &used, &text) != 0) {
+      fprintf(stderr, "Malformed seat map at byte %zu\n", pos);
+      result = 1;
+      break;
+    }
+    if (write_all(STDOUT_FILENO, text.data, text.len) != 0) {
+      perror("Error writing output");
+      result = 1;
+    }
+    pos += used;
+  }
+
+  buffer_free(&contents);
+  buffer_free(&text);
+  return result;
+}
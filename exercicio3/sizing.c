@@ -0,0 +1,92 @@
+#include "sizing.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "constants.h"
+
+/// Number of threads that keep the online CPUs busy.
+/// @param delay_ms State access delay in milliseconds.
+static size_t thread_budget(unsigned int delay_ms) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t budget = cpus > 0 ? (size_t)cpus : 1;
+  // A thread waiting on the delay leaves its core idle, so a core is kept busy by as many threads as fit one
+  // access's computation into its wait, plus one. The cap bounds the threads of very long delays.
+  size_t oversubscription = 1 + (size_t)delay_ms * 1000 / AUTO_CPU_US_PER_ACCESS;
+  if (oversubscription > AUTO_MAX_OVERSUBSCRIPTION) {
+    oversubscription = AUTO_MAX_OVERSUBSCRIPTION;
+  }
+  return budget * oversubscription;
+}
+
+int sizing_scan(const char* jobs_directory, struct Workload* workload) {
+  workload->num_files = 0;
+  workload->total_size = 0;
+  workload->largest_size = 0;
+
+  DIR* dir = opendir(jobs_directory);
+  if (dir == NULL) {
+    perror("Error opening JOBS directory");
+    return 1;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strstr(entry->d_name, ".jobs") == NULL) continue;
+
+    char path[4096];
+    struct stat info;
+    snprintf(path, sizeof(path), "%s/%s", jobs_directory, entry->d_name);
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) continue;
+
+    size_t size = (size_t)info.st_size;
+    workload->num_files++;
+    workload->total_size += size;
+    if (size > workload->largest_size) {
+      workload->largest_size = size;
+    }
+  }
+
+  closedir(dir);
+  return 0;
+}
+
+void sizing_choose(const struct Workload* workload, unsigned int delay_ms, int* max_processes, int* max_threads) {
+  size_t budget = thread_budget(delay_ms);
+
+  // Job files share nothing, so each can have a process of its own.
+  if (*max_processes == 0) {
+    size_t processes = workload->num_files < budget ? workload->num_files : budget;
+    *max_processes = processes > 0 ? (int)processes : 1;
+  }
+
+  if (*max_threads == 0) {
+    size_t threads = budget / (size_t)*max_processes;
+    // The other files are done before the largest one, whose threads then have the cores to themselves.
+    if (workload->total_size > 0) {
+      size_t largest_share = (size_t)((double)budget * (double)workload->largest_size / (double)workload->total_size);
+      if (largest_share > threads) {
+        threads = largest_share;
+      }
+    }
+    // Threads beyond the commands of the largest file have nothing to do.
+    size_t commands = workload->largest_size / AUTO_BYTES_PER_COMMAND;
+    if (threads > commands) {
+      threads = commands;
+    }
+    *max_threads = threads > 0 ? (int)threads : 1;
+  }
+
+  printf("Using %d processes with %d threads each\n", *max_processes, *max_threads);
+  fflush(stdout);
+}
+
+int sizing_server_threads(unsigned int delay_ms) {
+  size_t threads = thread_budget(delay_ms);
+  printf("Using %zu worker threads\n", threads);
+  fflush(stdout);
+  return (int)threads;
+}
@@ -0,0 +1,33 @@
+#ifndef EMS_SIZING_H
+#define EMS_SIZING_H
+
+#include <stddef.h>
+
+// Job files to be processed, as seen before starting.
+struct Workload {
+  size_t num_files;     // Number of .jobs files
+  size_t total_size;    // Sum of their sizes in bytes
+  size_t largest_size;  // Size of the largest one in bytes
+};
+
+/// Looks at the job files of a directory.
+/// @param jobs_directory Directory with the job files.
+/// @param workload Workload to be filled.
+/// @return 0 if the directory was read successfully, 1 otherwise.
+int sizing_scan(const char* jobs_directory, struct Workload* workload);
+
+/// Chooses the number of processes and threads for a workload from the online CPUs. A workload with a
+/// state access delay mostly sleeps, so it gets more threads than cores, the more the longer the delay; a
+/// CPU-bound one gets at most one per core. The largest job file finishes last, so threads are sized for its share of the work.
+/// @param workload Workload to be processed.
+/// @param delay_ms State access delay in milliseconds.
+/// @param max_processes Pointer to the number of processes, chosen if 0.
+/// @param max_threads Pointer to the number of threads of each process, chosen if 0.
+void sizing_choose(const struct Workload* workload, unsigned int delay_ms, int* max_processes, int* max_threads);
+
+/// Chooses the number of worker threads of a server from the online CPUs.
+/// @param delay_ms State access delay in milliseconds.
+/// @return Number of worker threads.
+int sizing_server_threads(unsigned int delay_ms);
+
+#endif  // EMS_SIZING_H
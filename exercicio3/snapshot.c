@@ -0,0 +1,391 @@
+#include "snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "mem.h"
+
+#define SNAPSHOT_MAGIC "EMSSNAP1"
+
+// First bytes of a snapshot file, followed by num_events descriptors.
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t generation;
+  uint32_t padding;
+  uint64_t wal_offset;
+  uint64_t num_events;
+};
+
+// Where the state of an event is stored in the snapshot file.
+struct SnapshotEvent {
+  uint32_t id;
+  uint32_t reservations;
+  uint64_t rows;
+  uint64_t cols;
+  uint32_t seat_width;
+  uint32_t sparse;        // Seats stored as per-row runs instead of a grid
+  uint64_t seats_offset;  // Page aligned, so the grid can be used in place
+  uint64_t seats_size;
+  uint64_t log_offset;  // For each reservation: number of seats, then the seat indices
+  uint64_t log_size;
+};
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+static int pwrite_all(int fd, const void* data, size_t len, uint64_t offset) {
+  const char* bytes = data;
+  while (len > 0) {
+    ssize_t written = pwrite(fd, bytes, len, (off_t)offset);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return 1;
+    }
+    bytes += written;
+    len -= (size_t)written;
+    offset += (uint64_t)written;
+  }
+  return 0;
+}
+
+/// Serializes the sparse rows of an event as, for each row, its number of runs followed by the runs.
+static int serialize_sparse(const struct Event* event, struct Buffer* out) {
+  for (size_t i = 0; i < event->rows; i++) {
+    uint64_t count = event->sparse_rows[i].count;
+    if (buffer_append(out, (const char*)&count, sizeof(count)) != 0 ||
+        buffer_append(out, (const char*)event->sparse_rows[i].runs, count * sizeof(struct SeatRun)) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int serialize_log(struct Event* event, struct Buffer* out) {
+  if (snapshot_load_log(event) != 0) return 1;
+
+  for (size_t i = 0; i < event->reservations; i++) {
+    const struct Reservation* reservation = &event->reservation_log[i];
+    uint64_t num_seats = reservation->num_seats;
+    if (buffer_append(out, (const char*)&num_seats, sizeof(num_seats)) != 0) return 1;
+    for (size_t j = 0; j < reservation->num_seats; j++) {
+      uint64_t seat = reservation->seats[j];
+      if (buffer_append(out, (const char*)&seat, sizeof(seat)) != 0) return 1;
+    }
+  }
+  return 0;
+}
+
+/// Writes the seats and reservation log of an event starting at offset.
+/// @return 0 on success, 1 otherwise. On success, offset is moved past the event's data.
+static int write_event(int fd, struct Event* event, struct SnapshotEvent* desc, uint64_t* offset, uint64_t page_size) {
+  struct Buffer out;
+  buffer_init(&out);
+
+  desc->id = event->id;
+  desc->reservations = event->reservations;
+  desc->rows = event->rows;
+  desc->cols = event->cols;
+  desc->seat_width = event->seat_width;
+  desc->sparse = event->sparse_rows != NULL;
+  desc->seats_offset = align_up(*offset, page_size);
+
+  int result;
+  if (event->sparse_rows) {
+    result = serialize_sparse(event, &out) || pwrite_all(fd, out.data, out.len, desc->seats_offset);
+    desc->seats_size = out.len;
+  } else {
+    desc->seats_size = event->rows * event->cols * event->seat_width;
+    result = pwrite_all(fd, event->data, desc->seats_size, desc->seats_offset);
+  }
+
+  out.len = 0;
+  desc->log_offset = align_up(desc->seats_offset + desc->seats_size, sizeof(uint64_t));
+  result = result || serialize_log(event, &out) || pwrite_all(fd, out.data, out.len, desc->log_offset);
+  desc->log_size = out.len;
+  *offset = desc->log_offset + desc->log_size;
+
+  buffer_free(&out);
+  return result;
+}
+
+/// Syncs the directory holding a file, so that a rename into it survives a crash.
+/// @return 0 if the directory was synced, 1 otherwise.
+static int sync_directory(const char* path) {
+  char dir[4096];
+  snprintf(dir, sizeof(dir), "%s", path);
+  char* slash = strrchr(dir, '/');
+  if (slash == NULL) {
+    snprintf(dir, sizeof(dir), ".");
+  } else if (slash == dir) {
+    slash[1] = '\0';
+  } else {
+    *slash = '\0';
+  }
+
+  int fd = open(dir, O_RDONLY | O_DIRECTORY);
+  if (fd < 0) return 1;
+  int result = fsync(fd) != 0;
+  close(fd);
+  return result;
+}
+
+int snapshot_write(const char* path, struct EventList* list, uint32_t generation, uint64_t wal_offset) {
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  int fd = open(tmp_path, O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    perror("Error creating snapshot");
+    return 1;
+  }
+
+  pthread_rwlock_rdlock(&list->lock);
+
+  struct SnapshotHeader header;
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.generation = generation;
+  header.padding = 0;
+  header.wal_offset = wal_offset;
+  header.num_events = list->size;
+
+  struct SnapshotEvent* descs = calloc(list->size + 1, sizeof(struct SnapshotEvent));
+  uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t offset = sizeof(header) + list->size * sizeof(struct SnapshotEvent);
+  int result = descs == NULL;
+
+  size_t i = 0;
+  for (struct ListNode* node = list->head; node != NULL && result == 0; node = node->next, i++) {
+    pthread_mutex_lock(&node->event->lock);
+    result = write_event(fd, node->event, &descs[i], &offset, page_size);
+    pthread_mutex_unlock(&node->event->lock);
+  }
+
+  result = result || pwrite_all(fd, &header, sizeof(header), 0) ||
+           pwrite_all(fd, descs, list->size * sizeof(struct SnapshotEvent), sizeof(header)) ||
+           ftruncate(fd, (off_t)offset) != 0 || fsync(fd) != 0;
+
+  pthread_rwlock_unlock(&list->lock);
+  free(descs);
+
+  if (close(fd) != 0 || result != 0 || rename(tmp_path, path) != 0) {
+    perror("Error writing snapshot");
+    unlink(tmp_path);
+    return 1;
+  }
+
+  if (sync_directory(path) != 0) {
+    perror("Error syncing snapshot directory");
+    return 1;
+  }
+
+  return 0;
+}
+
+/// Rebuilds the sparse rows of an event from their serialized form.
+static int load_sparse(struct Event* event, const char* data, size_t size) {
+  event->sparse_rows = mem_calloc(MEM_SEATS, event->rows, sizeof(struct SeatRow));
+  if (event->sparse_rows == NULL) return 1;
+
+  size_t offset = 0;
+  for (size_t i = 0; i < event->rows; i++) {
+    uint64_t count;
+    if (size - offset < sizeof(count)) return 1;
+    memcpy(&count, data + offset, sizeof(count));
+    offset += sizeof(count);
+
+    if (count == 0) continue;
+    if ((size - offset) / sizeof(struct SeatRun) < count) return 1;
+
+    struct SeatRow* row = &event->sparse_rows[i];
+    row->runs = mem_malloc(MEM_SEATS, count * sizeof(struct SeatRun));
+    if (row->runs == NULL) return 1;
+    memcpy(row->runs, data + offset, count * sizeof(struct SeatRun));
+    row->count = count;
+    row->capacity = count;
+    offset += count * sizeof(struct SeatRun);
+
+    // Runs are searched and split in place, so they must be sorted, apart and inside the row.
+    size_t end = 0;
+    for (size_t j = 0; j < count; j++) {
+      const struct SeatRun* run = &row->runs[j];
+      if (run->col < end || run->col >= event->cols || run->len == 0 || run->len > event->cols - run->col ||
+          run->reservation == 0 || run->reservation > event->reservations) {
+        return 1;
+      }
+      end = run->col + run->len;
+    }
+  }
+  return 0;
+}
+
+static void free_loaded_event(struct Event* event) {
+  if (event->sparse_rows) {
+    for (size_t i = 0; i < event->rows; i++) {
+      sparse_row_free(&event->sparse_rows[i]);
+    }
+    mem_free(event->sparse_rows);
+  }
+  pthread_mutex_destroy(&event->lock);
+  mem_free(event);
+}
+
+/// Checks that the reservation log of an event lies within its region and names seats of the event, so that
+/// snapshot_load_log can later copy it out without checks.
+/// @return 0 if the log is well formed, 1 otherwise.
+static int check_log(const uint64_t* log, uint64_t words, uint64_t reservations, uint64_t num_seats) {
+  const uint64_t* end = log + words;
+  for (uint64_t i = 0; i < reservations; i++) {
+    if (log == end) return 1;
+    uint64_t count = *log++;
+    if (count > (uint64_t)(end - log)) return 1;
+    for (uint64_t j = 0; j < count; j++) {
+      if (*log++ >= num_seats) return 1;
+    }
+  }
+  return 0;
+}
+
+static struct Event* load_event(const struct Snapshot* snapshot, const struct SnapshotEvent* desc) {
+  uint64_t num_seats, grid_size;
+  if (desc->seats_offset > snapshot->size || desc->seats_size > snapshot->size - desc->seats_offset ||
+      desc->log_offset > snapshot->size || desc->log_size > snapshot->size - desc->log_offset ||
+      desc->log_offset % sizeof(uint64_t) != 0 || desc->log_size % sizeof(uint64_t) != 0 ||
+      (desc->seat_width != 1 && desc->seat_width != 2 && desc->seat_width != 4) ||
+      __builtin_mul_overflow(desc->rows, desc->cols, &num_seats) ||
+      __builtin_mul_overflow(num_seats, desc->seat_width, &grid_size) || num_seats > SIZE_MAX ||
+      (!desc->sparse && (desc->seats_size != grid_size || desc->seats_offset % desc->seat_width != 0))) {
+    return NULL;
+  }
+
+  const uint64_t* log = (const uint64_t*)(const void*)((char*)snapshot->map + desc->log_offset);
+  if (check_log(log, desc->log_size / sizeof(uint64_t), desc->reservations, num_seats) != 0) return NULL;
+
+  struct Event* event = mem_malloc(MEM_EVENTS, sizeof(struct Event));
+  if (event == NULL) return NULL;
+
+  event->id = desc->id;
+  event->reservations = desc->reservations;
+  event->rows = desc->rows;
+  event->cols = desc->cols;
+  event->seat_width = (unsigned char)desc->seat_width;
+  event->data = NULL;
+  event->data_mapped = 0;
+  event->sparse_rows = NULL;
+  event->reservation_log = NULL;
+  event->log_capacity = 0;
+  event->snapshot_log = desc->reservations > 0 ? log : NULL;
+  event->free_runs = NULL;
+  event->deleted = 0;
+  pthread_mutex_init(&event->lock, NULL);
+
+  const char* seats = (const char*)snapshot->map + desc->seats_offset;
+  if (desc->sparse) {
+    if (load_sparse(event, seats, desc->seats_size) != 0) {
+      free_loaded_event(event);
+      return NULL;
+    }
+  } else {
+    // Copy-on-write pages of the mapping: only the seats that are touched are ever read from disk.
+    event->data = (char*)snapshot->map + desc->seats_offset;
+    event->data_mapped = 1;
+  }
+
+  return event;
+}
+
+int snapshot_load(const char* path, struct Snapshot* snapshot, int (*add_event)(struct Event* event)) {
+  snapshot->map = NULL;
+  snapshot->size = 0;
+  snapshot->generation = 0;
+  snapshot->wal_offset = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return errno == ENOENT ? 0 : 1;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct SnapshotHeader)) {
+    close(fd);
+    return 1;
+  }
+
+  void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return 1;
+
+  snapshot->map = map;
+  snapshot->size = (size_t)st.st_size;
+
+  struct SnapshotHeader header;
+  memcpy(&header, map, sizeof(header));
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.num_events > (snapshot->size - sizeof(header)) / sizeof(struct SnapshotEvent)) {
+    snapshot_unmap(snapshot);
+    return 1;
+  }
+
+  snapshot->generation = header.generation;
+  snapshot->wal_offset = header.wal_offset;
+
+  const struct SnapshotEvent* descs = (const struct SnapshotEvent*)((char*)map + sizeof(header));
+  for (uint64_t i = 0; i < header.num_events; i++) {
+    struct Event* event = load_event(snapshot, &descs[i]);
+    if (event == NULL) {
+      fprintf(stderr, "Corrupt snapshot event\n");
+      snapshot_unmap(snapshot);
+      return 1;
+    }
+    if (add_event(event) != 0) {
+      free_loaded_event(event);
+      snapshot_unmap(snapshot);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int snapshot_load_log(struct Event* event) {
+  if (event->snapshot_log == NULL) return 0;
+
+  struct Reservation* log = mem_calloc(MEM_RESERVATIONS, event->reservations, sizeof(struct Reservation));
+  if (log == NULL) return 1;
+
+  // Bounded by check_log when the snapshot was loaded.
+  const uint64_t* cursor = event->snapshot_log;
+  for (size_t i = 0; i < event->reservations; i++) {
+    size_t num_seats = (size_t)*cursor++;
+    if (num_seats > 0) {
+      log[i].seats = mem_malloc(MEM_RESERVATIONS, num_seats * sizeof(size_t));
+      if (log[i].seats == NULL) {
+        for (size_t j = 0; j < i; j++) {
+          mem_free(log[j].seats);
+        }
+        mem_free(log);
+        return 1;
+      }
+      for (size_t j = 0; j < num_seats; j++) {
+        log[i].seats[j] = (size_t)*cursor++;
+      }
+    }
+    log[i].num_seats = num_seats;
+  }
+
+  event->reservation_log = log;
+  event->log_capacity = event->reservations;
+  event->snapshot_log = NULL;
+  return 0;
+}
+
+void snapshot_unmap(struct Snapshot* snapshot) {
+  if (snapshot->map != NULL) {
+    munmap(snapshot->map, snapshot->size);
+  }
+  snapshot->map = NULL;
+  snapshot->size = 0;
+}
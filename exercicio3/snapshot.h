@@ -0,0 +1,43 @@
+#ifndef EMS_SNAPSHOT_H
+#define EMS_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "eventlist.h"
+
+// A loaded snapshot. Dense seat grids of its events point straight into the mapping.
+struct Snapshot {
+  void* map;            /// Private, copy-on-write mapping of the snapshot file, NULL if none.
+  size_t size;          /// Size of the mapping.
+  uint32_t generation;  /// Generation of the log the snapshot was taken from, 0 if none.
+  uint64_t wal_offset;  /// Size of that log when the snapshot was taken.
+};
+
+/// Writes every event of the list to a new snapshot file, replacing the old one atomically.
+/// @note The caller must keep the events from changing while the snapshot is written.
+/// @param path Path of the snapshot.
+/// @param list Events to be written, in list order.
+/// @param generation Generation of the current log.
+/// @param wal_offset Size of the current log, every record of which is reflected in the events.
+/// @return 0 if the snapshot was written successfully, 1 otherwise.
+int snapshot_write(const char* path, struct EventList* list, uint32_t generation, uint64_t wal_offset);
+
+/// Maps a snapshot file and rebuilds its events. Seat pages are only read when first accessed.
+/// @param path Path of the snapshot. A missing snapshot leaves the snapshot empty.
+/// @param snapshot Snapshot to be filled.
+/// @param add_event Function taking ownership of each event, in list order.
+/// @return 0 if the snapshot was loaded (or does not exist), 1 otherwise. On failure the snapshot is unmapped, so
+/// the events already added must be freed without touching their seats.
+int snapshot_load(const char* path, struct Snapshot* snapshot, int (*add_event)(struct Event* event));
+
+/// Copies the reservation log of an event loaded from a snapshot out of the mapping.
+/// @param event Event whose log is loaded, must be locked by the caller.
+/// @return 0 if the log is loaded, 1 on allocation failure.
+int snapshot_load_log(struct Event* event);
+
+/// Unmaps a snapshot. None of its events may be used afterwards.
+/// @param snapshot Snapshot to be unmapped.
+void snapshot_unmap(struct Snapshot* snapshot);
+
+#endif  // EMS_SNAPSHOT_H
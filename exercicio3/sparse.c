@@ -0,0 +1,130 @@
+#include "sparse.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+
+/// Finds the first run that starts after the given column.
+/// @param row Row to be searched.
+/// @param col Column (0-based).
+/// @return Position of the first run with a starting column greater than col.
+static size_t upper_bound(const struct SeatRow* row, size_t col) {
+  size_t low = 0;
+  size_t high = row->count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (row->runs[mid].col <= col) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static void insert_run(struct SeatRow* row, size_t pos, struct SeatRun run) {
+  memmove(&row->runs[pos + 1], &row->runs[pos], (row->count - pos) * sizeof(struct SeatRun));
+  row->runs[pos] = run;
+  row->count++;
+}
+
+static void remove_run(struct SeatRow* row, size_t pos) {
+  memmove(&row->runs[pos], &row->runs[pos + 1], (row->count - pos - 1) * sizeof(struct SeatRun));
+  row->count--;
+}
+
+/// Merges the run at pos with its right neighbour if they are adjacent and share a reservation.
+static void merge_right(struct SeatRow* row, size_t pos) {
+  if (pos + 1 >= row->count) return;
+
+  struct SeatRun* run = &row->runs[pos];
+  struct SeatRun* next = &row->runs[pos + 1];
+  if (run->reservation == next->reservation && run->col + run->len == next->col) {
+    run->len += next->len;
+    remove_run(row, pos + 1);
+  }
+}
+
+unsigned int sparse_row_get(const struct SeatRow* row, size_t col) {
+  size_t pos = upper_bound(row, col);
+  if (pos == 0) return 0;
+
+  const struct SeatRun* run = &row->runs[pos - 1];
+  return col < run->col + run->len ? run->reservation : 0;
+}
+
+int sparse_row_set(struct SeatRow* row, size_t col, unsigned int reservation) {
+  // A split can turn one run into three, so make room before touching anything.
+  if (row->count + 2 > row->capacity) {
+    size_t capacity = row->capacity ? row->capacity * 2 : 4;
+    struct SeatRun* runs = mem_realloc(MEM_SEATS, row->runs, capacity * sizeof(struct SeatRun));
+    if (!runs) return 1;
+    row->runs = runs;
+    row->capacity = capacity;
+  }
+
+  size_t pos = upper_bound(row, col);
+
+  if (pos > 0 && col < row->runs[pos - 1].col + row->runs[pos - 1].len) {
+    struct SeatRun run = row->runs[pos - 1];
+    if (run.reservation == reservation) return 0;
+
+    // Cut the seat out of the run that contains it.
+    pos--;
+    remove_run(row, pos);
+    if (col > run.col) {
+      insert_run(row, pos++, (struct SeatRun){run.col, col - run.col, run.reservation});
+    }
+    if (col + 1 < run.col + run.len) {
+      insert_run(row, pos, (struct SeatRun){col + 1, run.col + run.len - col - 1, run.reservation});
+    }
+  }
+
+  if (reservation == 0) return 0;
+
+  insert_run(row, pos, (struct SeatRun){col, 1, reservation});
+  merge_right(row, pos);
+  if (pos > 0) {
+    merge_right(row, pos - 1);
+  }
+
+  return 0;
+}
+
+int sparse_row_find_run(const struct SeatRow* row, size_t num_cols, size_t count, size_t* col) {
+  size_t start = 0;
+  for (size_t i = 0; i <= row->count; i++) {
+    size_t end = i < row->count ? row->runs[i].col : num_cols;
+    if (end - start >= count) {
+      *col = start;
+      return 0;
+    }
+    if (i < row->count) {
+      start = row->runs[i].col + row->runs[i].len;
+    }
+  }
+  return 1;
+}
+
+size_t sparse_row_free_seats(const struct SeatRow* row, size_t num_cols, size_t max, size_t* cols) {
+  size_t found = 0;
+  size_t start = 0;
+  for (size_t i = 0; i <= row->count && found < max; i++) {
+    size_t end = i < row->count ? row->runs[i].col : num_cols;
+    for (size_t col = start; col < end && found < max; col++) {
+      cols[found++] = col;
+    }
+    if (i < row->count) {
+      start = row->runs[i].col + row->runs[i].len;
+    }
+  }
+  return found;
+}
+
+void sparse_row_free(struct SeatRow* row) {
+  mem_free(row->runs);
+  row->runs = NULL;
+  row->count = 0;
+  row->capacity = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef EMS_SPARSE_H
+#define EMS_SPARSE_H
+
+#include <stddef.h>
+
+// Run of consecutive seats in a row that belong to the same reservation.
+struct SeatRun {
+  size_t col;                /// First column of the run (0-based).
+  size_t len;                /// Number of seats in the run.
+  unsigned int reservation;  /// Reservation id of every seat in the run.
+};
+
+// Reserved seats of a row, as runs sorted by column. Free seats are not stored.
+struct SeatRow {
+  struct SeatRun* runs;  /// Runs sorted by column, never overlapping.
+  size_t count;          /// Number of runs in use.
+  size_t capacity;       /// Number of runs allocated.
+};
+
+/// Gets the reservation of a seat in a sparse row.
+/// @param row Row to be searched.
+/// @param col Column of the seat (0-based).
+/// @return Reservation id of the seat, 0 if free.
+unsigned int sparse_row_get(const struct SeatRow* row, size_t col);
+
+/// Sets the reservation of a seat in a sparse row, splitting and merging runs as needed.
+/// @param row Row to be modified.
+/// @param col Column of the seat (0-based).
+/// @param reservation Reservation id to store, 0 to free the seat.
+/// @return 0 if the seat was set successfully, 1 on allocation failure.
+int sparse_row_set(struct SeatRow* row, size_t col, unsigned int reservation);
+
+/// Finds the first gap of free adjacent seats in a sparse row.
+/// @param row Row to be searched.
+/// @param num_cols Number of columns of the row.
+/// @param count Number of adjacent seats wanted.
+/// @param col Pointer to the variable to store the first column (0-based) in.
+/// @return 0 if a gap was found, 1 otherwise.
+int sparse_row_find_run(const struct SeatRow* row, size_t num_cols, size_t count, size_t* col);
+
+/// Lists the first free seats of a sparse row.
+/// @param row Row to be searched.
+/// @param num_cols Number of columns of the row.
+/// @param max Maximum number of seats to list.
+/// @param cols Array to store the columns (0-based) in.
+/// @return Number of seats listed.
+size_t sparse_row_free_seats(const struct SeatRow* row, size_t num_cols, size_t max, size_t* cols);
+
+/// Frees the runs of a sparse row.
+/// @param row Row to be freed.
+void sparse_row_free(struct SeatRow* row);
+
+#endif  // EMS_SPARSE_H
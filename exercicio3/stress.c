@@ -0,0 +1,312 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_COMMANDS 400
+#define DEFAULT_RUNS 5
+#define DEFAULT_DELAY_MS 0
+#define MAX_THREAD_COUNTS 16
+#define MAX_EVENTS 8  // Few events, so that commands keep conflicting over them
+#define MAX_SIDE 6    // Small events, so that reservations keep conflicting over seats
+
+// Commands the sequential engine of exercicio1 understands, in the proportions they are generated.
+enum JobCommand { JOB_CREATE, JOB_RESERVE, JOB_SHOW, JOB_LIST, JOB_BARRIER };
+
+// Events created so far by a generated job file, and the generator's state.
+struct Generator {
+  uint64_t state;
+  unsigned int num_events;
+  size_t rows[MAX_EVENTS + 1], cols[MAX_EVENTS + 1];  // By event id, 0 if not created
+};
+
+/// Gets the next pseudo-random number (xorshift64*), reproducible across platforms for a given seed.
+static uint64_t next_random(struct Generator* generator) {
+  generator->state ^= generator->state >> 12;
+  generator->state ^= generator->state << 25;
+  generator->state ^= generator->state >> 27;
+  return generator->state * 0x2545F4914F6CDD1DULL;
+}
+
+/// Gets a pseudo-random number from 0 to bound - 1.
+static size_t random_below(struct Generator* generator, size_t bound) {
+  return (size_t)(next_random(generator) % bound);
+}
+
+static enum JobCommand random_command(struct Generator* generator) {
+  size_t roll = random_below(generator, 100);
+  if (generator->num_events == 0 || roll < 8) return JOB_CREATE;
+  if (roll < 70) return JOB_RESERVE;
+  if (roll < 90) return JOB_SHOW;
+  if (roll < 96) return JOB_LIST;
+  return JOB_BARRIER;
+}
+
+/// Writes a random job file: CREATEs (some of them of existing events), RESERVEs of overlapping or
+/// repeated seats (some of them outside the event or of missing events), SHOWs, LISTs and BARRIERs,
+/// followed by a SHOW of every event so that the outputs end with the final state of every seat.
+/// @return 0 if the job file was written successfully, 1 otherwise.
+static int write_job_file(const char* path, uint64_t seed, unsigned int num_commands) {
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Error creating %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+
+  struct Generator generator = {seed * 2 + 1, 0, {0}, {0}};
+  for (unsigned int i = 0; i < num_commands; i++) {
+    // Mostly existing events, sometimes one that is missing.
+    unsigned int event_id = (unsigned int)random_below(&generator, MAX_EVENTS) + 1;
+    switch (random_command(&generator)) {
+      case JOB_CREATE: {
+        size_t rows = random_below(&generator, MAX_SIDE) + 1, cols = random_below(&generator, MAX_SIDE) + 1;
+        fprintf(file, "CREATE %u %zu %zu\n", event_id, rows, cols);
+        if (generator.rows[event_id] == 0) {
+          generator.rows[event_id] = rows;
+          generator.cols[event_id] = cols;
+          generator.num_events++;
+        }
+        break;
+      }
+
+      case JOB_RESERVE: {
+        size_t rows = generator.rows[event_id] > 0 ? generator.rows[event_id] : MAX_SIDE;
+        size_t cols = generator.cols[event_id] > 0 ? generator.cols[event_id] : MAX_SIDE;
+        size_t num_seats = random_below(&generator, 4) + 1;
+        fprintf(file, "RESERVE %u [", event_id);
+        for (size_t seat = 0; seat < num_seats; seat++) {
+          // One row or column past the event now and then.
+          size_t x = random_below(&generator, rows + (random_below(&generator, 20) == 0)) + 1;
+          size_t y = random_below(&generator, cols) + 1;
+          fprintf(file, "%s(%zu,%zu)", seat > 0 ? " " : "", x, y);
+        }
+        fprintf(file, "]\n");
+        break;
+      }
+
+      case JOB_SHOW:
+        fprintf(file, "SHOW %u\n", event_id);
+        break;
+
+      case JOB_LIST:
+        fprintf(file, "LIST\n");
+        break;
+
+      case JOB_BARRIER:
+        fprintf(file, "BARRIER\n");
+        break;
+    }
+  }
+  for (unsigned int event_id = 1; event_id <= MAX_EVENTS; event_id++) {
+    if (generator.rows[event_id] > 0) {
+      fprintf(file, "SHOW %u\n", event_id);
+    }
+  }
+
+  if (fclose(file) != 0) {
+    fprintf(stderr, "Error writing %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  return 0;
+}
+
+static double elapsed_seconds(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/// Runs an engine to completion, discarding what it prints.
+/// @param argv Command line of the engine, NULL terminated.
+/// @return Seconds the engine took, negative if it could not be run or did not exit successfully.
+static double run_engine(char* const argv[]) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("Error forking");
+    return -1;
+  }
+  if (pid == 0) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDOUT_FILENO);
+      dup2(null_fd, STDERR_FILENO);
+    }
+    execv(argv[0], argv);
+    _exit(127);
+  }
+
+  int status;
+  if (waitpid(pid, &status, 0) < 0) {
+    perror("Error waiting for engine");
+    return -1;
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s failed with status %d\n", argv[0], status);
+    return -1;
+  }
+  return elapsed_seconds(&start);
+}
+
+/// Compares two output files line by line, printing the first line where they diverge.
+/// @return 0 if the files are identical, 1 otherwise.
+static int compare_outputs(const char* expected_path, const char* actual_path) {
+  FILE* expected = fopen(expected_path, "r");
+  FILE* actual = fopen(actual_path, "r");
+  int result = 1;
+  if (expected == NULL || actual == NULL) {
+    fprintf(stderr, "Error opening %s\n", expected == NULL ? expected_path : actual_path);
+  } else {
+    char expected_line[4096], actual_line[4096];
+    for (unsigned long line = 1;; line++) {
+      char* e = fgets(expected_line, sizeof(expected_line), expected);
+      char* a = fgets(actual_line, sizeof(actual_line), actual);
+      if (e == NULL && a == NULL) {
+        result = 0;
+        break;
+      }
+      if (e == NULL || a == NULL || strcmp(e, a) != 0) {
+        printf("    line %lu: expected %s", line, e != NULL ? e : "end of output\n");
+        printf("    line %lu: got      %s", line, a != NULL ? a : "end of output\n");
+        break;
+      }
+    }
+  }
+  if (expected != NULL) fclose(expected);
+  if (actual != NULL) fclose(actual);
+  return result;
+}
+
+static unsigned int parse_uint(const char* text, const char* name, int allow_zero) {
+  char* endptr;
+  unsigned long value = strtoul(text, &endptr, 10);
+  if (*text == '\0' || *endptr != '\0' || (value == 0 && !allow_zero) || value > UINT_MAX) {
+    fprintf(stderr, "Invalid %s\n", name);
+    exit(1);
+  }
+  return (unsigned int)value;
+}
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [-s seed] [-n num_commands] [-r runs] [-d delay] <sequential_ems> <parallel_ems> "
+          "<threads>...\n"
+          "       Runs random job files through the sequential engine of exercicio1 and the parallel engine\n"
+          "       of exercicio3 with each number of threads, and compares their outputs.\n",
+          program);
+}
+
+int main(int argc, char* argv[]) {
+  unsigned int seed = (unsigned int)time(NULL), num_commands = DEFAULT_COMMANDS, runs = DEFAULT_RUNS;
+  unsigned int delay_ms = DEFAULT_DELAY_MS;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:r:d:")) != -1) {
+    switch (opt) {
+      case 's':
+        seed = parse_uint(optarg, "seed", 1);
+        break;
+      case 'n':
+        num_commands = parse_uint(optarg, "number of commands", 0);
+        break;
+      case 'r':
+        runs = parse_uint(optarg, "number of runs", 0);
+        break;
+      case 'd':
+        delay_ms = parse_uint(optarg, "delay", 1);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (argc - optind < 3 || argc - optind - 2 > MAX_THREAD_COUNTS) {
+    usage(argv[0]);
+    return 1;
+  }
+  char* sequential_ems = argv[optind];
+  char* parallel_ems = argv[optind + 1];
+  char* const* thread_counts = &argv[optind + 2];
+  int num_thread_counts = argc - optind - 2;
+  for (int i = 0; i < num_thread_counts; i++) {
+    parse_uint(thread_counts[i], "number of threads", 0);
+  }
+
+  // Each engine gets a directory of its own, holding nothing but the job file: the sequential engine
+  // keeps one state for every job file of its directory.
+  char directory[] = "/tmp/ems-stress-XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    perror("Error creating working directory");
+    return 1;
+  }
+  char sequential_dir[64], parallel_dir[64], job_path[128], expected_path[128], actual_path[128];
+  snprintf(sequential_dir, sizeof(sequential_dir), "%s/sequential", directory);
+  snprintf(parallel_dir, sizeof(parallel_dir), "%s/parallel", directory);
+  if (mkdir(sequential_dir, S_IRWXU) != 0 || mkdir(parallel_dir, S_IRWXU) != 0) {
+    perror("Error creating working directory");
+    return 1;
+  }
+  snprintf(expected_path, sizeof(expected_path), "%s/stress.out", sequential_dir);
+  snprintf(actual_path, sizeof(actual_path), "%s/stress.out", parallel_dir);
+
+  char delay[16];
+  snprintf(delay, sizeof(delay), "%u", delay_ms);
+  char* sequential_argv[] = {sequential_ems, sequential_dir, delay, NULL};
+
+  printf("%10s %8s %12s %12s %8s  %s\n", "seed", "threads", "sequential", "parallel", "speedup", "result");
+  unsigned int divergences = 0, failures = 0;
+  for (unsigned int run = 0; run < runs; run++) {
+    unsigned int run_seed = seed + run;
+    snprintf(job_path, sizeof(job_path), "%s/stress.jobs", sequential_dir);
+    if (write_job_file(job_path, run_seed, num_commands) != 0) return 1;
+    snprintf(job_path, sizeof(job_path), "%s/stress.jobs", parallel_dir);
+    if (write_job_file(job_path, run_seed, num_commands) != 0) return 1;
+
+    double sequential_time = run_engine(sequential_argv);
+    if (sequential_time < 0) {
+      failures++;
+      continue;
+    }
+    for (int i = 0; i < num_thread_counts; i++) {
+      char* parallel_argv[] = {parallel_ems, parallel_dir, "1", thread_counts[i], delay, NULL};
+      unlink(actual_path);
+      double parallel_time = run_engine(parallel_argv);
+      if (parallel_time < 0) {
+        printf("%10u %8s %11.3fs %12s %8s  FAILED\n", run_seed, thread_counts[i], sequential_time, "-", "-");
+        failures++;
+        continue;
+      }
+      int diverged = compare_outputs(expected_path, actual_path) != 0;
+      printf("%10u %8s %11.3fs %11.3fs %7.2fx  %s\n", run_seed, thread_counts[i], sequential_time, parallel_time,
+             sequential_time / parallel_time, diverged ? "DIVERGED" : "ok");
+      divergences += (unsigned int)diverged;
+    }
+    fflush(stdout);
+  }
+
+  if (divergences > 0 || failures > 0) {
+    // Kept for the divergent job file and outputs to be looked at.
+    printf("%u divergent runs, %u failed runs; last job file and outputs left in %s\n", divergences, failures,
+           directory);
+    return 1;
+  }
+  unlink(expected_path);
+  unlink(actual_path);
+  snprintf(job_path, sizeof(job_path), "%s/stress.jobs", sequential_dir);
+  unlink(job_path);
+  snprintf(job_path, sizeof(job_path), "%s/stress.jobs", parallel_dir);
+  unlink(job_path);
+  rmdir(sequential_dir);
+  rmdir(parallel_dir);
+  rmdir(directory);
+  printf("No divergence in %u runs\n", runs);
+  return 0;
+}
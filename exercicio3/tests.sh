@@ -0,0 +1,135 @@
+#!/bin/sh
+# Checks the public job files in every mode, the SHOW BIN seat maps against SHOW, and recovery from the
+# write-ahead log, after a clean exit and after a crash. Run from exercicio3 after make, or with make test.
+
+cd "$(dirname "$0")" || exit 1
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+fail() {
+  echo "FAIL: $*"
+  failed=1
+}
+
+# Job files whose output depends on how the events are split: a RESERVE_MULTI across shards is rejected,
+# and STATS MEM lists every shard.
+shard_skip="10 12"
+
+# Runs every public job file in a fresh directory and compares the outputs with the results.
+# usage: check_public <name> <skip> <ems arguments before the directory> -- <arguments after it>
+check_public() {
+  name=$1
+  skip=$2
+  shift 2
+  rm -rf "$tmp/jobs" && mkdir "$tmp/jobs" && cp public/*.jobs "$tmp/jobs/"
+  before=""
+  while [ "$1" != "--" ]; do
+    before="$before $1"
+    shift
+  done
+  shift
+  # shellcheck disable=SC2086
+  ./ems $before "$tmp/jobs" "$@" >/dev/null 2>&1 || fail "$name: ems exited with $?"
+  for result in public/*.result; do
+    n=$(basename "$result" .result)
+    case " $skip " in *" $n "*) continue ;; esac
+    cmp -s "$tmp/jobs/$n.out" "$result" || fail "$name: $n.out differs from $n.result"
+  done
+}
+
+# Runs every public job file against a server of its own, as a server keeps its state between job files.
+check_server() {
+  for jobs in public/*.jobs; do
+    n=$(basename "$jobs" .jobs)
+    rm -rf "$tmp/jobs" "$tmp/reg" && mkdir "$tmp/jobs" && cp "$jobs" "$tmp/jobs/"
+    ./ems -s "$tmp/reg" 2 0 2>/dev/null &
+    server=$!
+    while [ ! -p "$tmp/reg" ] && kill -0 "$server" 2>/dev/null; do sleep 0.05; done
+    ./ems -c "$tmp/reg" "$tmp/jobs" 1 4 0 >/dev/null 2>&1 || fail "server: client exited with $? on $n.jobs"
+    kill -INT "$server"
+    wait "$server"
+    cmp -s "$tmp/jobs/$n.out" "public/$n.result" || fail "server: $n.out differs from $n.result"
+  done
+}
+
+# The seat maps of SHOW BIN must decode to what SHOW prints.
+check_show_bin() {
+  rm -rf "$tmp/bin" "$tmp/text" && mkdir "$tmp/bin" "$tmp/text"
+  for jobs in public/*.jobs; do
+    grep -q "^SHOW BIN" "$jobs" || continue
+    n=$(basename "$jobs" .jobs)
+    cp "$jobs" "$tmp/bin/"
+    sed 's/^SHOW BIN/SHOW/' "$jobs" >"$tmp/text/$n.jobs"
+  done
+  ./ems "$tmp/bin" 1 1 0 >/dev/null 2>&1 && ./ems "$tmp/text" 1 1 0 >/dev/null 2>&1 || fail "show bin: ems exited with $?"
+  for out in "$tmp"/bin/*.out; do
+    n=$(basename "$out" .out)
+    ./showdecode "$out" | cmp -s - "$tmp/text/$n.out" || fail "show bin: $n.out does not decode to SHOW"
+  done
+}
+
+# Lists the events of a job file, shows them and queries their first reservations.
+inspect() {
+  echo LIST
+  for id in $(sed -n 's/^CREATE \([0-9]*\) .*/\1/p' "$1" | sort -un); do
+    echo "SHOW $id"
+    for reservation in 1 2 3 4; do
+      echo "QUERY $id $reservation"
+    done
+  done
+}
+
+# Runs a job file with a write-ahead log, restarts on the same log and inspects the recovered state. Both
+# runs must print what a single run without the log prints. With crash, the first run is killed once it is
+# done instead of exiting, so that recovery replays the log without a snapshot.
+# usage: check_recovery <job file> [crash]
+check_recovery() {
+  n=$(basename "$1" .jobs)
+  rm -rf "$tmp/wal" "$tmp/ref" && mkdir "$tmp/wal" "$tmp/ref"
+  inspect "$1" >"$tmp/inspect"
+  cp "$1" "$tmp/ref/"
+  # The last line of a job file may have no newline.
+  { cat "$1"; echo; cat "$tmp/inspect"; } >"$tmp/ref/full.jobs"
+  ./ems "$tmp/ref" 1 1 0 >/dev/null 2>&1
+  size=$(wc -c <"$tmp/ref/$n.out")
+
+  if [ "$2" = crash ]; then
+    { cat "$1"; echo; echo "WAIT 60000"; } >"$tmp/wal/$n.jobs"
+    ./ems -w "$tmp/wal" 1 1 0 >/dev/null 2>&1 &
+    pid=$!
+    tries=0
+    while [ "$(cat "$tmp/wal/$n.out" 2>/dev/null | wc -c)" -lt "$size" ] && [ $tries -lt 600 ]; do
+      sleep 0.05
+      tries=$((tries + 1))
+    done
+    # The job file is run by a child of ems, which has to go down with it.
+    pkill -KILL -P "$pid"
+    kill -KILL "$pid"
+    wait "$pid" 2>/dev/null
+    [ -e "$tmp/wal/$n.snap" ] && fail "recovery: $n.jobs wrote a snapshot before the crash"
+  else
+    cp "$1" "$tmp/wal/"
+    ./ems -w "$tmp/wal" 1 1 0 >/dev/null 2>&1 || fail "recovery: first run of $n.jobs exited with $?"
+  fi
+  cmp -s "$tmp/wal/$n.out" "$tmp/ref/$n.out" || fail "recovery: first run of $n.jobs ${2:-} differs"
+
+  cp "$tmp/inspect" "$tmp/wal/$n.jobs"
+  ./ems -w "$tmp/wal" 1 1 0 >/dev/null 2>&1 || fail "recovery: restart of $n.jobs ${2:-} exited with $?"
+  tail -c +$((size + 1)) "$tmp/ref/full.out" | cmp -s - "$tmp/wal/$n.out" ||
+    fail "recovery: state recovered from $n.jobs ${2:-} differs"
+}
+
+check_public "1 thread" "" -- 1 1 0
+check_public "4 threads" "" -- 2 4 0
+check_public "pipeline" "" -p -- 1 4 0
+check_public "shards" "$shard_skip" -n 2 -- 1 2 0
+check_server
+check_show_bin
+for jobs in public/*.jobs; do
+  check_recovery "$jobs"
+  check_recovery "$jobs" crash
+done
+
+[ $failed = 0 ] && echo "All tests passed"
+exit $failed
@@ -0,0 +1,101 @@
+#include "timerwheel.h"
+
+#include <stddef.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/// Number of ticks covered by a slot of a level.
+static uint64_t slot_width(int level) { return (uint64_t)1 << (TIMER_WHEEL_BITS * level); }
+
+void timer_wheel_init(struct TimerWheel* wheel, uint64_t now) {
+  wheel->now = now;
+  wheel->due = NULL;
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+      wheel->slots[level][slot] = NULL;
+    }
+  }
+}
+
+void timer_wheel_add(struct TimerWheel* wheel, struct Timer* timer) {
+  if (timer->expires <= wheel->now) {
+    timer->next = wheel->due;
+    wheel->due = timer;
+    return;
+  }
+
+  // The lowest level whose slots still reach the expiry in a single turn.
+  uint64_t delta = timer->expires - wheel->now;
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >= slot_width(level + 1)) {
+    level++;
+  }
+  // Beyond the top level, a timer waits in its farthest slot and is placed again from there.
+  uint64_t position = delta < slot_width(TIMER_WHEEL_LEVELS) ? timer->expires
+                                                                : wheel->now + slot_width(TIMER_WHEEL_LEVELS) - 1;
+  struct Timer** slot = &wheel->slots[level][(position >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+  timer->next = *slot;
+  *slot = timer;
+}
+
+struct Timer* timer_wheel_advance(struct TimerWheel* wheel, uint64_t now) {
+  struct Timer* expired = wheel->due;
+  wheel->due = NULL;
+
+  while (wheel->now < now) {
+    uint64_t tick = ++wheel->now;
+
+    // Entering a slot of a higher level brings its timers down, before level 0 expires this tick's.
+    for (int level = 1; level < TIMER_WHEEL_LEVELS && (tick & (slot_width(level) - 1)) == 0; level++) {
+      struct Timer** slot = &wheel->slots[level][(tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+      struct Timer* timer = *slot;
+      *slot = NULL;
+      while (timer != NULL) {
+        struct Timer* next = timer->next;
+        timer_wheel_add(wheel, timer);
+        timer = next;
+      }
+    }
+
+    struct Timer** slot = &wheel->slots[0][tick & SLOT_MASK];
+    while (*slot != NULL) {
+      struct Timer* timer = *slot;
+      *slot = timer->next;
+      timer->next = expired;
+      expired = timer;
+    }
+    // Timers cascaded straight to due expire now too.
+    while (wheel->due != NULL) {
+      struct Timer* timer = wheel->due;
+      wheel->due = timer->next;
+      timer->next = expired;
+      expired = timer;
+    }
+  }
+
+  return expired;
+}
+
+int timer_wheel_next(const struct TimerWheel* wheel, uint64_t* when) {
+  if (wheel->due != NULL) {
+    *when = wheel->now;
+    return 1;
+  }
+
+  int found = 0;
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    // The first non-empty slot after the current one, which is already processed.
+    uint64_t current = wheel->now >> (TIMER_WHEEL_BITS * level);
+    for (uint64_t k = 1; k <= TIMER_WHEEL_SLOTS; k++) {
+      if (wheel->slots[level][(current + k) & SLOT_MASK] != NULL) {
+        uint64_t start = (current + k) << (TIMER_WHEEL_BITS * level);
+        if (!found || start < *when) {
+          *when = start;
+        }
+        found = 1;
+        break;
+      }
+    }
+  }
+  return found;
+}
@@ -0,0 +1,48 @@
+#ifndef EMS_TIMERWHEEL_H
+#define EMS_TIMERWHEEL_H
+
+#include <stdint.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+
+// Timer kept by a timer wheel, embedded in whatever it wakes up.
+struct Timer {
+  uint64_t expires;  // Tick at which it expires
+  struct Timer* next;
+};
+
+// Hierarchical timer wheel. Level 0 has a slot per tick for the next TIMER_WHEEL_SLOTS ticks; every level
+// above has slots TIMER_WHEEL_SLOTS times wider, whose timers are cascaded down when their slot comes up.
+// Adding a timer and expiring it take constant time, whatever the number of timers.
+struct TimerWheel {
+  uint64_t now;       // Latest tick processed
+  struct Timer* due;  // Timers added already expired
+  struct Timer* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+/// Initializes an empty timer wheel.
+/// @param wheel Timer wheel to be initialized.
+/// @param now Current tick.
+void timer_wheel_init(struct TimerWheel* wheel, uint64_t now);
+
+/// Adds a timer. A timer that has already expired expires on the next advance.
+/// @param wheel Timer wheel to add the timer to.
+/// @param timer Timer to be added, with its expiry set.
+void timer_wheel_add(struct TimerWheel* wheel, struct Timer* timer);
+
+/// Moves the wheel forward, expiring timers.
+/// @param wheel Timer wheel to be moved.
+/// @param now Current tick.
+/// @return List of the timers expired, linked through their next field.
+struct Timer* timer_wheel_advance(struct TimerWheel* wheel, uint64_t now);
+
+/// Gets the earliest tick at which advancing the wheel has work to do: expiring timers, or cascading them
+/// closer to their expiry.
+/// @param wheel Timer wheel to be looked at.
+/// @param when Pointer to the variable to store the tick in.
+/// @return 1 if the wheel has timers, 0 if it is empty.
+int timer_wheel_next(const struct TimerWheel* wheel, uint64_t* when);
+
+#endif  // EMS_TIMERWHEEL_H
@@ -0,0 +1,282 @@
+#include "wal.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+
+// On-disk header of a record, followed by num_fields 32-bit fields.
+struct WalRecordHeader {
+  uint32_t type;
+  uint32_t num_fields;
+  uint32_t checksum;  // FNV-1a of type, num_fields and the fields
+};
+
+static int wal_fd = -1;
+static unsigned int wal_flush_interval_ms = 0;
+
+static pthread_t commit_thread;
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond = PTHREAD_COND_INITIALIZER;  // Signalled when records are queued
+static pthread_cond_t durable_cond = PTHREAD_COND_INITIALIZER;  // Signalled after every flush
+
+static struct Buffer pending;     // Encoded records waiting for the next group commit
+static uint64_t appended_lsn = 0;  // Sequence number of the last queued record
+static uint64_t rotated_lsn = 0;   // Sequence number of the last record before the latest rotation
+static uint64_t durable_lsn = 0;   // Sequence number of the last record on disk
+static int closing = 0;
+static int failed = 0;
+
+static uint32_t checksum(uint32_t type, const uint32_t* fields, size_t num_fields) {
+  uint32_t hash = 2166136261u;
+  uint32_t header[2] = {type, (uint32_t)num_fields};
+  const unsigned char* bytes = (const unsigned char*)header;
+  for (size_t i = 0; i < sizeof(header); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  bytes = (const unsigned char*)fields;
+  for (size_t i = 0; i < num_fields * sizeof(uint32_t); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+long wal_replay(const char* path, uint32_t generation, uint64_t offset, wal_apply_fn apply, int* generation_matched) {
+  *generation_matched = 0;
+  int fd = open(path, O_RDWR);
+  if (fd < 0) return 0;
+
+  struct Buffer log;
+  buffer_init(&log);
+  char chunk[4096];
+  ssize_t bytes;
+  while ((bytes = read(fd, chunk, sizeof(chunk))) > 0) {
+    if (buffer_append(&log, chunk, (size_t)bytes) != 0) {
+      bytes = -1;
+      break;
+    }
+  }
+  if (bytes < 0) {
+    buffer_free(&log);
+    close(fd);
+    return -1;
+  }
+
+  long records = 0;
+  size_t position = 0;
+  size_t skip_until = 0;
+  uint32_t* fields = NULL;
+  while (position + sizeof(struct WalRecordHeader) <= log.len) {
+    struct WalRecordHeader header;
+    memcpy(&header, log.data + position, sizeof(header));
+
+    size_t size = (size_t)header.num_fields * sizeof(uint32_t);
+    if (size > log.len - position - sizeof(header)) break;
+
+    uint32_t* resized = realloc(fields, size ? size : 1);
+    if (!resized) break;
+    fields = resized;
+    memcpy(fields, log.data + position + sizeof(header), size);
+    if (checksum(header.type, fields, header.num_fields) != header.checksum) break;
+
+    if (header.type == WAL_GENERATION) {
+      // Records before the checkpoint offset are already part of the snapshot.
+      if (position == 0 && header.num_fields == 1 && fields[0] == generation && offset <= log.len) {
+        skip_until = (size_t)offset;
+        *generation_matched = 1;
+      }
+    } else if (position >= skip_until) {
+      if (apply((enum WalRecordType)header.type, fields, header.num_fields) != 0) {
+        fprintf(stderr, "Skipping log record that could not be applied\n");
+      }
+      records++;
+    }
+    position += sizeof(header) + size;
+  }
+
+  // Whatever follows the last valid record was torn by a crash.
+  if (position < log.len && ftruncate(fd, (off_t)position) != 0) {
+    perror("Error truncating log");
+  }
+
+  free(fields);
+  buffer_free(&log);
+  close(fd);
+  return records;
+}
+
+static void* commit_loop(void* arg) {
+  (void)arg;
+
+  struct Buffer batch;
+  buffer_init(&batch);
+
+  pthread_mutex_lock(&wal_mutex);
+  while (1) {
+    while (pending.len == 0 && !closing) {
+      pthread_cond_wait(&pending_cond, &wal_mutex);
+    }
+    if (pending.len == 0) break;
+
+    // Let more records join this commit before paying for the sync.
+    if (wal_flush_interval_ms > 0 && !closing) {
+      pthread_mutex_unlock(&wal_mutex);
+      struct timespec delay = {wal_flush_interval_ms / 1000, (wal_flush_interval_ms % 1000) * 1000000};
+      nanosleep(&delay, NULL);
+      pthread_mutex_lock(&wal_mutex);
+    }
+
+    struct Buffer swap = batch;
+    batch = pending;
+    pending = swap;
+    pending.len = 0;
+    uint64_t batch_lsn = appended_lsn;
+    pthread_mutex_unlock(&wal_mutex);
+
+    int error = write_all(wal_fd, batch.data, batch.len) != 0 || fdatasync(wal_fd) != 0;
+    if (error) {
+      perror("Error writing log");
+    }
+
+    pthread_mutex_lock(&wal_mutex);
+    failed |= error;
+    durable_lsn = batch_lsn;
+    pthread_cond_broadcast(&durable_cond);
+  }
+  pthread_mutex_unlock(&wal_mutex);
+
+  buffer_free(&batch);
+  return NULL;
+}
+
+/// Writes the generation record that starts every log and syncs it.
+static int write_generation(uint32_t generation) {
+  struct WalRecordHeader header = {WAL_GENERATION, 1, checksum(WAL_GENERATION, &generation, 1)};
+  return write_all(wal_fd, (const char*)&header, sizeof(header)) != 0 ||
+         write_all(wal_fd, (const char*)&generation, sizeof(generation)) != 0 || fdatasync(wal_fd) != 0;
+}
+
+int wal_open(const char* path, unsigned int flush_interval_ms, uint32_t generation) {
+  if (wal_fd >= 0) {
+    fprintf(stderr, "Log is already open\n");
+    return 1;
+  }
+
+  wal_fd = open(path, O_WRONLY | O_APPEND | O_CREAT, S_IRUSR | S_IWUSR);
+  if (wal_fd < 0) {
+    perror("Error opening log");
+    return 1;
+  }
+
+  struct stat st;
+  if (fstat(wal_fd, &st) != 0 || (st.st_size == 0 && write_generation(generation) != 0)) {
+    perror("Error starting log");
+    close(wal_fd);
+    wal_fd = -1;
+    return 1;
+  }
+
+  wal_flush_interval_ms = flush_interval_ms;
+  buffer_init(&pending);
+  appended_lsn = 0;
+  rotated_lsn = 0;
+  durable_lsn = 0;
+  closing = 0;
+  failed = 0;
+
+  if (pthread_create(&commit_thread, NULL, commit_loop, NULL) != 0) {
+    perror("Error creating log thread");
+    close(wal_fd);
+    wal_fd = -1;
+    return 1;
+  }
+
+  return 0;
+}
+
+uint64_t wal_append(enum WalRecordType type, const uint32_t* fields, size_t num_fields) {
+  if (wal_fd < 0) return 0;
+
+  struct WalRecordHeader header = {(uint32_t)type, (uint32_t)num_fields, checksum((uint32_t)type, fields, num_fields)};
+
+  pthread_mutex_lock(&wal_mutex);
+  if (buffer_append(&pending, (const char*)&header, sizeof(header)) != 0 ||
+      buffer_append(&pending, (const char*)fields, num_fields * sizeof(uint32_t)) != 0) {
+    fprintf(stderr, "Error queueing log record\n");
+    failed = 1;
+  }
+  uint64_t lsn = ++appended_lsn;
+  pthread_cond_signal(&pending_cond);
+  pthread_mutex_unlock(&wal_mutex);
+
+  return lsn;
+}
+
+int wal_wait(uint64_t lsn) {
+  if (lsn == 0) return 0;
+
+  pthread_mutex_lock(&wal_mutex);
+  while (durable_lsn < lsn) {
+    pthread_cond_wait(&durable_cond, &wal_mutex);
+  }
+  int result = failed;
+  pthread_mutex_unlock(&wal_mutex);
+
+  return result;
+}
+
+uint64_t wal_records() {
+  pthread_mutex_lock(&wal_mutex);
+  uint64_t records = appended_lsn - rotated_lsn;
+  pthread_mutex_unlock(&wal_mutex);
+  return records;
+}
+
+int wal_sync(uint64_t* size) {
+  if (wal_fd < 0) return 1;
+
+  pthread_mutex_lock(&wal_mutex);
+  uint64_t lsn = appended_lsn;
+  pthread_mutex_unlock(&wal_mutex);
+
+  struct stat st;
+  if (wal_wait(lsn) != 0 || fstat(wal_fd, &st) != 0) return 1;
+
+  *size = (uint64_t)st.st_size;
+  return 0;
+}
+
+int wal_rotate(uint32_t generation) {
+  if (wal_fd < 0) return 1;
+
+  uint64_t size;
+  if (wal_sync(&size) != 0 || ftruncate(wal_fd, 0) != 0 || write_generation(generation) != 0) {
+    perror("Error rotating log");
+    return 1;
+  }
+
+  pthread_mutex_lock(&wal_mutex);
+  rotated_lsn = appended_lsn;
+  pthread_mutex_unlock(&wal_mutex);
+  return 0;
+}
+
+void wal_close() {
+  if (wal_fd < 0) return;
+
+  pthread_mutex_lock(&wal_mutex);
+  closing = 1;
+  pthread_cond_signal(&pending_cond);
+  pthread_mutex_unlock(&wal_mutex);
+
+  pthread_join(commit_thread, NULL);
+  buffer_free(&pending);
+  close(wal_fd);
+  wal_fd = -1;
+}
@@ -0,0 +1,69 @@
+#ifndef EMS_WAL_H
+#define EMS_WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Operations recorded in the write-ahead log. Every record is a list of 32-bit fields.
+enum WalRecordType {
+  WAL_CREATE = 1,         // event_id, num_rows, num_cols
+  WAL_RESERVE = 2,        // event_id, num_seats, then num_seats (x, y) pairs
+  WAL_CANCEL = 3,         // event_id, reservation_id
+  WAL_RESERVE_MULTI = 4,  // num_events, then one WAL_RESERVE payload per event
+  WAL_GENERATION = 5,     // generation, always the first record of a log
+  WAL_DELETE = 6,         // event_id
+};
+
+/// Function called for every valid record found while replaying a log.
+/// @return 0 if the record was applied, 1 otherwise (replay goes on).
+typedef int (*wal_apply_fn)(enum WalRecordType type, const uint32_t* fields, size_t num_fields);
+
+/// Replays an existing log, stopping at the first torn or corrupt record and cutting it off.
+/// @param path Path of the log. A missing log is an empty one.
+/// @param generation Generation of the snapshot the state was loaded from, 0 if none.
+/// @param offset Size the log had when that snapshot was taken. If the log still belongs to the
+/// snapshot's generation, the records before offset are already in the state and are skipped.
+/// @param apply Function applying each record to the state.
+/// @param generation_matched Pointer to the variable to store whether the log belongs to the snapshot's generation in.
+/// @return Number of records replayed, -1 if the log could not be read.
+long wal_replay(const char* path, uint32_t generation, uint64_t offset, wal_apply_fn apply, int* generation_matched);
+
+/// Opens the log for appending and starts the group commit thread.
+/// @param path Path of the log.
+/// @param flush_interval_ms Time the commit thread waits for more records before each flush.
+/// @param generation Generation written at the start of the log if it is empty.
+/// @return 0 if the log was opened successfully, 1 otherwise.
+int wal_open(const char* path, unsigned int flush_interval_ms, uint32_t generation);
+
+/// Queues a record to be written by the next group commit.
+/// @param type Type of the record.
+/// @param fields Fields of the record.
+/// @param num_fields Number of fields.
+/// @return Sequence number of the record, to be passed to wal_wait. 0 if the log is not open.
+uint64_t wal_append(enum WalRecordType type, const uint32_t* fields, size_t num_fields);
+
+/// Waits until a record is durable on disk.
+/// @param lsn Sequence number returned by wal_append. 0 returns immediately.
+/// @return 0 if the record is durable, 1 if the log failed to write it.
+int wal_wait(uint64_t lsn);
+
+/// Number of records queued since the log was opened or last rotated.
+/// @return Number of records.
+uint64_t wal_records();
+
+/// Makes every queued record durable.
+/// @note No records may be appended concurrently.
+/// @param size Pointer to the variable to store the size of the log in.
+/// @return 0 if the log is durable, 1 otherwise.
+int wal_sync(uint64_t* size);
+
+/// Empties the log after a checkpoint and starts a new generation.
+/// @note No records may be appended concurrently.
+/// @param generation Generation of the new log.
+/// @return 0 if the log was rotated successfully, 1 otherwise.
+int wal_rotate(uint32_t generation);
+
+/// Flushes every queued record, stops the group commit thread and closes the log.
+void wal_close();
+
+#endif  // EMS_WAL_H